@@ -0,0 +1,68 @@
+#include "AutoSaveStats.h"
+
+#include "AutoSaveSubsystem.h"
+
+DEFINE_STAT(STAT_AutoSaveTick);
+DEFINE_STAT(STAT_AutoSaveTaskDone);
+DEFINE_STAT(STAT_AutoSaveTaskStart);
+DEFINE_STAT(STAT_AutoSaveMaintenance);
+DEFINE_STAT(STAT_AutoSaveSnapshots);
+DEFINE_STAT(STAT_AutoSaveLoadDelegates);
+DEFINE_STAT(STAT_AutoSaveFlush);
+
+DEFINE_STAT(STAT_AutoSaveLoadTask);
+DEFINE_STAT(STAT_AutoSaveSaveTask);
+
+DEFINE_STAT(STAT_AutoSaveLoadNum);
+DEFINE_STAT(STAT_AutoSaveSaveNum);
+DEFINE_STAT(STAT_AutoSaveBytesRead);
+DEFINE_STAT(STAT_AutoSaveBytesWritten);
+
+DEFINE_STAT(STAT_AutoSaveStructNum);
+DEFINE_STAT(STAT_AutoSaveQueuedTaskNum);
+DEFINE_STAT(STAT_AutoSaveInFlightTaskNum);
+DEFINE_STAT(STAT_AutoSaveSaveBacklogNum);
+DEFINE_STAT(STAT_AutoSaveResidentSize);
+DEFINE_STAT(STAT_AutoSavePayloadSize);
+DEFINE_STAT(STAT_AutoSavePayloadCacheSize);
+
+void FAutoSaveLatencyHistogram::Add(double Seconds)
+{
+	const uint64 Microseconds = (uint64)FMath::Max(Seconds * 1000000.0, 0.0);
+
+	const int32 BucketIndex = Microseconds ? FMath::Min<int32>(64 - FPlatformMath::CountLeadingZeros64(Microseconds), BucketNum - 1) : 0;
+
+	Buckets[BucketIndex].Increment();
+}
+
+int64 FAutoSaveLatencyHistogram::GetNum() const
+{
+	int64 Result = 0;
+
+	for (const FThreadSafeCounter64& Bucket : Buckets)
+	{
+		Result += Bucket.GetValue();
+	}
+
+	return Result;
+}
+
+double FAutoSaveLatencyHistogram::GetPercentile(float Percentile) const
+{
+	const int64 Num = GetNum();
+
+	if (Num == 0) return 0.0;
+
+	const int64 Rank = FMath::Clamp<int64>((int64)FMath::CeilToDouble((double)Percentile * Num), 1, Num);
+
+	int64 Count = 0;
+
+	for (int32 BucketIndex = 0; BucketIndex < BucketNum; ++BucketIndex)
+	{
+		Count += Buckets[BucketIndex].GetValue();
+
+		if (Count >= Rank) return (double)(1ull << BucketIndex) / 1000000.0;
+	}
+
+	return (double)(1ull << (BucketNum - 1)) / 1000000.0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+DECLARE_STATS_GROUP(TEXT("AutoSave"), STATGROUP_AutoSave, STATCAT_Advanced);
+
+// Game thread phases, the tick as a whole is the stat of the tickable object
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Tick"), STAT_AutoSaveTick, STATGROUP_AutoSave, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Task Done"), STAT_AutoSaveTaskDone, STATGROUP_AutoSave, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Task Start"), STAT_AutoSaveTaskStart, STATGROUP_AutoSave, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Maintenance"), STAT_AutoSaveMaintenance, STATGROUP_AutoSave, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Snapshots"), STAT_AutoSaveSnapshots, STATGROUP_AutoSave, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Load Delegates"), STAT_AutoSaveLoadDelegates, STATGROUP_AutoSave, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Flush"), STAT_AutoSaveFlush, STATGROUP_AutoSave, );
+
+// Worker threads
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Load Task"), STAT_AutoSaveLoadTask, STATGROUP_AutoSave, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Save Task"), STAT_AutoSaveSaveTask, STATGROUP_AutoSave, );
+
+// Per frame
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Loads"), STAT_AutoSaveLoadNum, STATGROUP_AutoSave, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Saves"), STAT_AutoSaveSaveNum, STATGROUP_AutoSave, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Bytes Read"), STAT_AutoSaveBytesRead, STATGROUP_AutoSave, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Bytes Written"), STAT_AutoSaveBytesWritten, STATGROUP_AutoSave, );
+
+// Set every tick
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Structs"), STAT_AutoSaveStructNum, STATGROUP_AutoSave, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Queued Tasks"), STAT_AutoSaveQueuedTaskNum, STATGROUP_AutoSave, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("In Flight Tasks"), STAT_AutoSaveInFlightTaskNum, STATGROUP_AutoSave, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Save Backlog"), STAT_AutoSaveSaveBacklogNum, STATGROUP_AutoSave, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Resident Size"), STAT_AutoSaveResidentSize, STATGROUP_AutoSave, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Payload Size"), STAT_AutoSavePayloadSize, STATGROUP_AutoSave, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Payload Cache Size"), STAT_AutoSavePayloadCacheSize, STATGROUP_AutoSave, );
@@ -1,10 +1,144 @@
 #include "AutoSaveSubsystem.h"
 
 #include "AutoSaveLog.h"
+#include "AutoSaveStats.h"
+#include "SaveStructPack.h"
+#include "SaveStructPlan.h"
+#include "SaveStructAllocator.h"
+#include "SaveStructFormat.h"
+#include "SaveStructJournal.h"
+#include "SaveStructSnapshot.h"
+#include "AutoSaveThrottle.h"
+#include "Hash/CityHash.h"
 #include "Engine/UserDefinedStruct.h"
+#include "Async/ParallelFor.h"
+#include "Async/MappedFileHandle.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/ScopeRWLock.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
 #include "Serialization/MemoryReader.h"	
+#include "Serialization/LargeMemoryReader.h"
 #include "Serialization/MemoryWriter.h"	
 
+namespace
+{
+	// Snapshot buffers larger than this are freed instead of pooled, so one large struct does not hold its size for the session
+	const int32 MaxPooledSnapshotSize = 64 * 1024;
+
+	// Times a file access of a task, the rest of the task counts as serialization
+	struct FScopedIO
+	{
+		FAutoSaveCounters& Counters;
+
+		uint64& TaskIOCycles;
+
+		const uint64 StartCycles;
+
+		FScopedIO(FAutoSaveCounters& InCounters, uint64& InTaskIOCycles)
+			: Counters(InCounters)
+			, TaskIOCycles(InTaskIOCycles)
+			, StartCycles(FPlatformTime::Cycles64())
+		{ }
+
+		~FScopedIO()
+		{
+			const uint64 Cycles = FPlatformTime::Cycles64() - StartCycles;
+
+			TaskIOCycles += Cycles;
+			Counters.IOLatency.Add(FPlatformTime::ToSeconds64(Cycles));
+		}
+	};
+
+	void RecordBytesRead(FAutoSaveCounters& Counters, int64& TaskBytesRead, int64 Num)
+	{
+		TaskBytesRead += Num;
+		Counters.BytesRead.Add(Num);
+		INC_DWORD_STAT_BY(STAT_AutoSaveBytesRead, Num);
+	}
+
+	void RecordBytesWritten(FAutoSaveCounters& Counters, int64& TaskBytesWritten, int64 Num)
+	{
+		TaskBytesWritten += Num;
+		Counters.BytesWritten.Add(Num);
+		INC_DWORD_STAT_BY(STAT_AutoSaveBytesWritten, Num);
+	}
+
+	// Durable writes are flushed to the disk before the file is closed
+	bool WriteFile(const FString& Filename, const TArray<uint8>& Data, bool bDurable)
+	{
+		if (!bDurable) return FFileHelper::SaveArrayToFile(Data, *Filename);
+
+		IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+		PlatformFile.CreateDirectoryTree(*FPaths::GetPath(Filename));
+
+		TUniquePtr<IFileHandle> FileHandle(PlatformFile.OpenWrite(*Filename));
+
+		return FileHandle && FileHandle->Write(Data.GetData(), Data.Num()) && FileHandle->Flush(true);
+	}
+
+	FString GetGroupCommitDir()
+	{
+		return FPaths::ProjectSavedDir() / TEXT("AutoSave") / TEXT("Commits");
+	}
+
+	// Move the staged files of a group in place, the manifest is kept until all of them are moved.
+	// The moves themselves are not flushed, with bKeepManifest it is left for the next start, which completes any move a crash has undone.
+	bool CompleteGroupCommit(const FString& ManifestFilename, const FString& TempSuffix, const TArray<FString>& Filenames, bool bKeepManifest = false)
+	{
+		for (const FString& Filename : Filenames)
+		{
+			const FString TempFilename = Filename + TempSuffix;
+
+			// Moved before an interruption
+			if (!FPaths::FileExists(TempFilename)) continue;
+
+			if (!IFileManager::Get().Move(*Filename, *TempFilename, true, true))
+			{
+				UE_LOG(LogAutoSave, Error, TEXT("Failed to commit Save Struct '%s', the commit is completed at the next start."), *Filename);
+				return false;
+			}
+		}
+
+		if (!bKeepManifest)
+		{
+			IFileManager::Get().Delete(*ManifestFilename, false, false, true);
+		}
+
+		return true;
+	}
+
+	void RecoverGroupCommits()
+	{
+		TArray<FString> Manifests;
+		IFileManager::Get().FindFiles(Manifests, *(GetGroupCommitDir() / TEXT("*.commit")), true, false);
+
+		// The names start with the commit time, so a later commit of the same struct is moved last
+		Manifests.Sort();
+
+		for (const FString& Manifest : Manifests)
+		{
+			const FString ManifestFilename = GetGroupCommitDir() / Manifest;
+
+			TArray<FString> Lines;
+
+			if (!FFileHelper::LoadFileToStringArray(Lines, *ManifestFilename) || !Lines.Num())
+			{
+				IFileManager::Get().Delete(*ManifestFilename, false, false, true);
+				continue;
+			}
+
+			UE_LOG(LogAutoSave, Warning, TEXT("Completing the interrupted commit '%s'."), *Manifest);
+
+			const FString TempSuffix = Lines[0];
+			Lines.RemoveAt(0);
+
+			CompleteGroupCommit(ManifestFilename, TempSuffix, Lines);
+		}
+	}
+}
+
 UAutoSaveSubsystem::UAutoSaveSubsystem(const class FObjectInitializer & ObjectInitializer)
 {
 }
@@ -15,7 +149,7 @@ FString UAutoSaveSubsystem::GetSaveStructDebugString() const
 
 #if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
 
-	for (const TPair<FString, TUniquePtr<FSaveStructInfo>>& Info : StructInfos)
+	for (const TPair<FString, FSaveStructInfo*>& Info : StructInfos)
 	{
 		Result.Append(Info.Value->Filename);
 
@@ -27,6 +161,9 @@ FString UAutoSaveSubsystem::GetSaveStructDebugString() const
 
 		switch (Info.Value->State)
 		{
+		case ESaveStructState::Pending:
+			Result.Append(TEXT("Pending"));
+			break;
 		case ESaveStructState::Preload:
 			Result.Append(TEXT("Preload"));
 			break;
@@ -39,6 +176,12 @@ FString UAutoSaveSubsystem::GetSaveStructDebugString() const
 		case ESaveStructState::Saving:
 			Result.Append(TEXT("Saving"));
 			break;
+		case ESaveStructState::Failed:
+			Result.Append(TEXT("Failed"));
+			break;
+		case ESaveStructState::Snapshotting:
+			Result.Append(TEXT("Snapshotting"));
+			break;
 		default: checkNoEntry();
 		}
 
@@ -64,21 +207,51 @@ FString UAutoSaveSubsystem::GetSaveStructDebugString() const
 
 int32 UAutoSaveSubsystem::GetIdleThreadNum() const
 {
-	int32 Result = 0;
+	if (!TaskPool) return 0;
 
-	for (const TUniquePtr<FAsyncTask<FStructLoadOrSaveTask>>& Task : TaskThreads)
-	{
-		if (!Task) ++Result;
-	}
+	return FMath::Max(MaxThreadNum - GetInFlightWorkNum(), 0);
+}
 
-	return Result;
+float UAutoSaveSubsystem::GetGameThreadTimePerTask() const
+{
+	if (Counters.GameThreadTaskNum == 0) return 0.0f;
+
+	return FPlatformTime::ToSeconds64(Counters.GameThreadTaskCycles) / Counters.GameThreadTaskNum;
+}
+
+FAutoSavePayloadStats UAutoSaveSubsystem::GetPayloadStats() const
+{
+	return PayloadAllocator ? PayloadAllocator->GetStats() : FAutoSavePayloadStats();
+}
+
+int32 UAutoSaveSubsystem::GetInfoPoolCapacity() const
+{
+	return InfoPool ? InfoPool->GetCapacity() : 0;
+}
+
+FSaveStruct * UAutoSaveSubsystem::AddSaveStructRef(const FString& Filename, UScriptStruct * ScriptStruct, ESaveStructPriority Priority)
+{
+	FSaveStructInfo* StructInfo = AddStructRef(Filename, ScriptStruct, Priority);
+
+	return StructInfo ? (FSaveStruct*)StructInfo->Data : nullptr;
 }
 
-FSaveStruct * UAutoSaveSubsystem::AddSaveStructRef(const FString& Filename, UScriptStruct * ScriptStruct)
+FSaveStructInfo* UAutoSaveSubsystem::AddStructRef(const FString& Filename, UScriptStruct* ScriptStruct, ESaveStructPriority Priority)
 {
-	if (StructInfos.Contains(Filename))
+	if (bDeinitialized)
+	{
+		UE_LOG(LogAutoSave, Warning, TEXT("The subsystem is deinitialized, But Save Struct '%s' was tried to add the reference."), *Filename);
+		return nullptr;
+	}
+
+	if (Priority != ESaveStructPriority::CriticalLoad)
+	{
+		Priority = ESaveStructPriority::NormalLoad;
+	}
+
+	if (FSaveStructInfo** Info = StructInfos.Find(Filename))
 	{
-		FSaveStructInfo* StructInfo = StructInfos[Filename].Get();
+		FSaveStructInfo* StructInfo = *Info;
 
 		if (ScriptStruct && ScriptStruct != StructInfo->Struct)
 		{
@@ -86,106 +259,215 @@ FSaveStruct * UAutoSaveSubsystem::AddSaveStructRef(const FString& Filename, UScr
 			return nullptr;
 		}
 
-		// Increase the reference count of SaveStruct by one, and then decrease it accordingly in UAutoSaveSubsystem::RemoveSaveStructRef
-		StructInfo->RefConut++;
+		// A failed struct without references is loaded again instead of handed out
+		if (StructInfo->State == ESaveStructState::Failed && StructInfo->RefConut <= 0)
+		{
+			ReleaseStruct(StructInfo);
+		}
+		else
+		{
+			const bool bWasReleased = StructInfo->RefConut <= 0;
+
+			const bool bWaitingForLoad = StructInfo->State == ESaveStructState::Pending || StructInfo->State == ESaveStructState::Preload;
+
+			// A struct still waiting to be loaded moves up to the requested class
+			const bool bRaisePriority = bWaitingForLoad && (bWasReleased || Priority < StructInfo->Priority);
+
+			if (bRaisePriority)
+			{
+				StructInfo->Priority = Priority;
+			}
+
+			// Increase the reference count of SaveStruct by one, and then decrease it accordingly in UAutoSaveSubsystem::RemoveSaveStructRef
+			StructInfo->RefConut++;
+
+			if (StructInfo->ResidentNode)
+			{
+				ResidentSize -= StructInfo->ResidentSize;
+				ResidentList.RemoveNode(StructInfo->ResidentNode);
+				StructInfo->ResidentNode = nullptr;
+
+				Counters.ResidentHitNum++;
+			}
+
+			// Revived resident structs need periodic saves again, and prefetched structs become demand loads
+			if (bWasReleased || bRaisePriority)
+			{
+				ScheduleStruct(StructInfo);
+			}
 
-		return (FSaveStruct*)StructInfo->Data.GetData();
+			return StructInfo;
+		}
 	}
 
 	if (!ScriptStruct) return nullptr;
 
+	Counters.ResidentMissNum++;
+
+	return CreateStructInfo(Filename, ScriptStruct, Priority);
+}
+
+FSaveStructInfo* UAutoSaveSubsystem::CreateStructInfo(const FString& Filename, UScriptStruct* ScriptStruct, ESaveStructPriority Priority, int32 PrefetchPriority)
+{
 	const bool bIsCppStruct = ScriptStruct->IsChildOf(FSaveStruct::StaticStruct());
 	const bool bIsBlueprintStruct = ScriptStruct->GetClass() == UUserDefinedStruct::StaticClass();
 
 	if (!bIsCppStruct && !bIsBlueprintStruct)
 		return nullptr;
 
-	TUniquePtr<FSaveStructInfo> NewStructInfo(new FSaveStructInfo());
+	FSaveStructInfo* NewStructInfo = InfoPool->Allocate();
+
+	const ESaveStructCompression* CompressionOverride = StructCompression.Num() ? StructCompression.Find(TSoftObjectPtr<UScriptStruct>(ScriptStruct)) : nullptr;
+
+	NewStructInfo->Compression = CompressionOverride ? *CompressionOverride : Compression;
+
+	NewStructInfo->Filename = Filename;
+	NewStructInfo->Struct = ScriptStruct;
+	NewStructInfo->RefConut = Priority == ESaveStructPriority::PrefetchLoad ? 0 : 1;
+	NewStructInfo->LastRefConut = 0;
+	NewStructInfo->LastSaveTime = FDateTime::Now();
+	NewStructInfo->PrefetchPriority = PrefetchPriority;
+	NewStructInfo->Priority = Priority;
+	if (bSerializationPlans && FSaveStructPlan::CanUse(ScriptStruct))
+	{
+		TSharedPtr<FSaveStructPlan>& Plan = SerializationPlans.FindOrAdd(ScriptStruct);
+
+		if (!Plan)
+		{
+			Plan = MakeShared<FSaveStructPlan>(ScriptStruct);
+		}
+
+		NewStructInfo->Plan = Plan;
+	}
+
+	NewStructInfo->DataSize = ScriptStruct->GetStructureSize();
+	NewStructInfo->DataAlignment = ScriptStruct->GetMinAlignment();
+	NewStructInfo->Data = PayloadAllocator->Allocate(NewStructInfo->DataSize, NewStructInfo->DataAlignment);
+	ScriptStruct->InitializeStruct(NewStructInfo->Data);
 
-	if (FPaths::FileExists(Filename))
+	if (!Pack)
+	{
+		// The file is checked and created by the task, so acquiring never waits for the disk
+		NewStructInfo->State = ESaveStructState::Pending;
+	}
+	else if (Pack->Contains(Filename))
 	{
-		NewStructInfo->Filename = Filename;
-		NewStructInfo->Struct = ScriptStruct;
 		NewStructInfo->State = ESaveStructState::Preload;
-		NewStructInfo->RefConut = 1;
-		NewStructInfo->LastRefConut = 0;
-		NewStructInfo->LastSaveTime = FDateTime::Now();
-		NewStructInfo->Data.SetNumUninitialized(ScriptStruct->GetStructureSize());
-		ScriptStruct->InitializeStruct(NewStructInfo->Data.GetData());
 	}
 	else
 	{
-		// Check if the target is writable
-		if (!FFileHelper::SaveStringToFile(TEXT(""), *Filename))
-			return nullptr;
-
-		NewStructInfo->Filename = Filename;
-		NewStructInfo->Struct = ScriptStruct;
 		NewStructInfo->State = ESaveStructState::Idle;
-		NewStructInfo->RefConut = 1;
-		NewStructInfo->LastRefConut = 0;
-		NewStructInfo->LastSaveTime = FDateTime::Now();
-		NewStructInfo->Data.SetNumUninitialized(ScriptStruct->GetStructureSize());
-		ScriptStruct->InitializeStruct(NewStructInfo->Data.GetData());
+		NewStructInfo->bDirty = true;
 	}
 
-	ScriptStructHooker.Add(Filename, ScriptStruct);
+	const int32 SlotIndex = FreeSlots.Num() ? FreeSlots.Pop(false) : Slots.AddDefaulted();
+
+	if (!ScriptStructHooker.IsValidIndex(SlotIndex))
+	{
+		ScriptStructHooker.SetNum(SlotIndex + 1);
+	}
+
+	ScriptStructHooker[SlotIndex] = ScriptStruct;
+
+	Slots[SlotIndex].Info = NewStructInfo;
+
+	NewStructInfo->Handle.Index = SlotIndex;
+	NewStructInfo->Handle.Generation = Slots[SlotIndex].Generation;
+
+	StructInfos.Add(Filename, NewStructInfo);
+
+	NewStructInfo->PartitionIndex = FindFilePartition(Filename);
+	NewStructInfo->PartitionMemberIndex = GetPartition(NewStructInfo).Members.Add(NewStructInfo);
 
-	StructInfos.Add(Filename, nullptr);
-	StructInfos[Filename].Reset(NewStructInfo.Release());
+	ScheduleStruct(NewStructInfo);
 
-	return (FSaveStruct*)StructInfos[Filename]->Data.GetData();
+	return NewStructInfo;
 }
 
-FSaveStruct * UAutoSaveSubsystem::AddSaveStructRef(const FString & Filename, UScriptStruct * ScriptStruct, FSaveStructLoadDelegate LoadCallback)
+int32 UAutoSaveSubsystem::PrefetchSaveStructs(const TArray<FSaveStructPrefetchRequest>& Requests, int32 Priority)
 {
-	FSaveStruct* Result = AddSaveStructRef(Filename, ScriptStruct);
+	if (bDeinitialized)
+	{
+		UE_LOG(LogAutoSave, Warning, TEXT("The subsystem is deinitialized, But Save Structs were tried to prefetch."));
+		return 0;
+	}
 
-	if (!LoadCallback.IsBound()) return Result;
+	// Prefetched structs have no references, they are released as soon as they are loaded without a resident budget
+	if (ResidentCacheBudget <= 0)
+	{
+		UE_LOG(LogAutoSave, Warning, TEXT("Prefetching Save Structs has no effect without ResidentCacheBudget."));
+		return 0;
+	}
 
-	if (!Result) return nullptr;
+	int32 Result = 0;
 
-	if (!LoadDelegates.Contains(Filename))
+	for (const FSaveStructPrefetchRequest& Request : Requests)
 	{
-		LoadDelegates.Add(Filename);
-	}
+		if (!Request.ScriptStruct || StructInfos.Contains(Request.Filename)) continue;
 
-	LoadDelegates[Filename].Add(LoadCallback);
+		// Missing records of the pack have nothing to prefetch
+		if (Pack && !Pack->Contains(Request.Filename)) continue;
+
+		if (CreateStructInfo(Request.Filename, Request.ScriptStruct, ESaveStructPriority::PrefetchLoad, Priority))
+		{
+			++Result;
+		}
+	}
 
 	return Result;
 }
 
-FSaveStruct * UAutoSaveSubsystem::AddSaveStructRef(const FString & Filename, UScriptStruct * ScriptStruct, FSaveStructLoadDynamicDelegate LoadCallback)
+FSaveStruct * UAutoSaveSubsystem::AddSaveStructRef(const FString & Filename, UScriptStruct * ScriptStruct, FSaveStructLoadDelegate LoadCallback, ESaveStructPriority Priority)
+{
+	FSaveStructInfo* StructInfo = AddStructRef(Filename, ScriptStruct, Priority);
+
+	if (!StructInfo) return nullptr;
+
+	AddLoadDelegate(StructInfo, LoadCallback);
+
+	return (FSaveStruct*)StructInfo->Data;
+}
+
+FSaveStruct * UAutoSaveSubsystem::AddSaveStructRef(const FString & Filename, UScriptStruct * ScriptStruct, FSaveStructLoadDynamicDelegate LoadCallback, ESaveStructPriority Priority)
 {
-	FSaveStruct* Result = AddSaveStructRef(Filename, ScriptStruct);
+	FSaveStructInfo* StructInfo = AddStructRef(Filename, ScriptStruct, Priority);
 
-	if (!LoadCallback.IsBound()) return Result;
+	if (!StructInfo) return nullptr;
 
-	if (!Result) return nullptr;
+	AddLoadDelegate(StructInfo, LoadCallback);
 
-	if (!LoadDynamicDelegates.Contains(Filename))
+	return (FSaveStruct*)StructInfo->Data;
+}
+
+void UAutoSaveSubsystem::AddLoadDelegate(FSaveStructInfo* Info, FSaveStructLoadDelegate LoadCallback)
+{
+	if (!LoadCallback.IsBound()) return;
+
+	if (!Info->LoadDelegates.IsBound() && !Info->LoadDynamicDelegates.IsBound())
 	{
-		LoadDynamicDelegates.Add(Filename);
+		LoadDelegateStructs.Add(Info->Handle);
 	}
 
-	LoadDynamicDelegates[Filename].Add(LoadCallback);
+	Info->LoadDelegates.Add(LoadCallback);
+}
 
-	return Result;
+void UAutoSaveSubsystem::AddLoadDelegate(FSaveStructInfo* Info, FSaveStructLoadDynamicDelegate LoadCallback)
+{
+	if (!LoadCallback.IsBound()) return;
+
+	if (!Info->LoadDelegates.IsBound() && !Info->LoadDynamicDelegates.IsBound())
+	{
+		LoadDelegateStructs.Add(Info->Handle);
+	}
+
+	Info->LoadDynamicDelegates.Add(LoadCallback);
 }
 
 void UAutoSaveSubsystem::RemoveSaveStructRef(const FString& Filename)
 {
-	if (StructInfos.Contains(Filename))
+	if (FSaveStructInfo** Info = StructInfos.Find(Filename))
 	{
-		if (StructInfos[Filename]->RefConut > 0)
-		{
-			// Decrement the reference count of SaveStruct by one, and increase it accordingly in UAutoSaveSubsystem::AddSaveStructRef
-			StructInfos[Filename]->RefConut--;
-		}
-		else
-		{
-			UE_LOG(LogAutoSave, Warning, TEXT("Save Struct '%s' reference is negative, But was tried to remove the reference."), *Filename);
-		}
+		RemoveStructRef(*Info);
 	}
 	else
 	{
@@ -193,278 +475,2386 @@ void UAutoSaveSubsystem::RemoveSaveStructRef(const FString& Filename)
 	}
 }
 
-UAutoSaveSubsystem::FStructLoadOrSaveTask::FStructLoadOrSaveTask(FSaveStructInfo * InStructInfoPtr)
-	: StructInfoPtr(InStructInfoPtr)
+void UAutoSaveSubsystem::RemoveSaveStructRef(FSaveStructHandle Handle)
 {
-	StructInfoPtr->LastRefConut = StructInfoPtr->RefConut;
-	StructInfoPtr->LastSaveTime = FDateTime::Now();
-
-	switch (StructInfoPtr->State)
+	if (FSaveStructInfo* Info = FindStruct(Handle))
 	{
-	case ESaveStructState::Preload:
-		StructInfoPtr->State = ESaveStructState::Loading;
-		DataCopy = StructInfoPtr->Data;
-		break;
-
-	case ESaveStructState::Idle:
-		StructInfoPtr->State = ESaveStructState::Saving;
-		DataCopy = StructInfoPtr->Data;
-		break;
-
-	default: checkNoEntry()
+		RemoveStructRef(Info);
 	}
-}
-
-UAutoSaveSubsystem::FStructLoadOrSaveTask::~FStructLoadOrSaveTask()
-{
-	switch (StructInfoPtr->State)
+	else
 	{
-	case ESaveStructState::Loading:
-		StructInfoPtr->State = ESaveStructState::Idle;
-		StructInfoPtr->Data = DataCopy;
-		break;
-
-	case ESaveStructState::Saving:
-		StructInfoPtr->State = ESaveStructState::Idle;
-		break;
-
-	default: checkNoEntry()
+		UE_LOG(LogAutoSave, Warning, TEXT("Save Struct handle %d is stale, But was tried to remove the reference."), Handle.Index);
 	}
 }
 
-void UAutoSaveSubsystem::FStructLoadOrSaveTask::DoWork()
+void UAutoSaveSubsystem::RemoveStructRef(FSaveStructInfo* Info)
 {
-	switch (StructInfoPtr->State)
-	{
-	case ESaveStructState::Loading:
-		LoadWork();
-		break;
+	// The info has been destroyed by Deinitialize
+	if (bDeinitialized) return;
 
-	case ESaveStructState::Saving:
-		SaveWork();
-		break;
+	if (Info->RefConut > 0)
+	{
+		// Decrement the reference count of SaveStruct by one, and increase it accordingly in UAutoSaveSubsystem::AddSaveStructRef
+		Info->RefConut--;
 
-	default: checkNoEntry()
+		// The last reference is gone, let the scheduler save and release it as soon as possible
+		if (Info->RefConut == 0)
+		{
+			ScheduleStruct(Info);
+		}
+	}
+	else
+	{
+		UE_LOG(LogAutoSave, Warning, TEXT("Save Struct '%s' reference is negative, But was tried to remove the reference."), *Info->Filename);
 	}
 }
 
-void UAutoSaveSubsystem::FStructLoadOrSaveTask::LoadWork()
+bool UAutoSaveSubsystem::IsSaveStructLoaded(const FString& Filename) const
 {
-	TArray<uint8> DataBuffer;
-
-	const bool bSuccessful = FFileHelper::LoadFileToArray(DataBuffer, *StructInfoPtr->Filename);
-
-	check(bSuccessful);
-
-	FMemoryReader MemoryReader(DataBuffer);
+	FSaveStructInfo* const* Info = StructInfos.Find(Filename);
 
-	UScriptStruct* Struct = StructInfoPtr->Struct;
-
-	check(Struct);
-
-	Struct->SerializeItem(MemoryReader, DataCopy.GetData(), nullptr);
+	return Info && (*Info)->IsLoaded();
 }
 
-void UAutoSaveSubsystem::FStructLoadOrSaveTask::SaveWork()
+bool UAutoSaveSubsystem::IsSaveStructLoaded(FSaveStructHandle Handle) const
 {
-	TArray<uint8> DataBuffer;
-	FMemoryWriter MemoryWriter(DataBuffer);
+	const FSaveStructInfo* Info = FindStruct(Handle);
 
-	UScriptStruct* Struct = StructInfoPtr->Struct;
+	return Info && Info->IsLoaded();
+}
 
-	check(Struct);
+FSaveStructHandle UAutoSaveSubsystem::GetSaveStructHandle(const FString& Filename) const
+{
+	FSaveStructInfo* const* Info = StructInfos.Find(Filename);
 
-	Struct->SerializeItem(MemoryWriter, DataCopy.GetData(), nullptr);
+	return Info ? (*Info)->Handle : FSaveStructHandle();
+}
 
-	const bool bSuccessful = FFileHelper::SaveArrayToFile(DataBuffer, *StructInfoPtr->Filename);
+FSaveStruct* UAutoSaveSubsystem::GetSaveStruct(FSaveStructHandle Handle) const
+{
+	FSaveStructInfo* Info = FindStruct(Handle);
 
-	check(bSuccessful);
+	return Info ? (FSaveStruct*)Info->Data : nullptr;
 }
 
-void UAutoSaveSubsystem::HandleTaskStart()
+void UAutoSaveSubsystem::SetSaveStructGroup(const FString& Filename, FName Group)
 {
-	const FDateTime NowTime = FDateTime::Now();
+	FSaveStructInfo** Info = StructInfos.Find(Filename);
 
-	TFunction<FSaveStructInfo*(void)> FindPreHandleStruct = [&]() -> FSaveStructInfo*
+	if (!Info)
 	{
-		FSaveStructInfo* PreHandleStruct = nullptr;
-
-		for (const TPair<FString, TUniquePtr<FSaveStructInfo>>& Info : StructInfos)
-		{
-			check(Info.Value);
-
-			if (Info.Value->State == ESaveStructState::Preload)
-			{
-				PreHandleStruct = Info.Value.Get();
-				break;
-			}
-
-			if (Info.Value->State != ESaveStructState::Idle) continue;
-			
-			if (Info.Value->RefConut == 0)
-			{
-				PreHandleStruct = Info.Value.Get();
-				break;
-			}
-
-			const bool bTimeout = PreHandleStruct
-				? PreHandleStruct->LastSaveTime > Info.Value->LastSaveTime
-				: NowTime - Info.Value->LastSaveTime > SaveWaitTime;
+		UE_LOG(LogAutoSave, Warning, TEXT("Save Struct '%s' is invalid, But was tried to set the group."), *Filename);
+		return;
+	}
 
-			if (bTimeout)
-			{
-				PreHandleStruct = Info.Value.Get();
-			}
-		}
+	FSaveStructInfo* StructInfo = *Info;
 
-		return PreHandleStruct;
-	};
+	if (StructInfo->SaveGroup == Group) return;
 
-	if (MaxThreadNum <= 0)
+	if (StructInfo->SaveGroup != NAME_None)
 	{
-		FSaveStructInfo* PreHandleStruct = FindPreHandleStruct();
-
-		if (PreHandleStruct) 
-		{
-			FAsyncTask<FStructLoadOrSaveTask> Task(PreHandleStruct);
-			Task.StartSynchronousTask();
-		}
+		SaveGroups.RemoveSingle(StructInfo->SaveGroup, StructInfo);
 	}
 
-	for (TUniquePtr<FAsyncTask<FStructLoadOrSaveTask>>& Task : TaskThreads)
-	{
-		if (Task) continue;
-
-		FSaveStructInfo* PreHandleStruct = FindPreHandleStruct();
-
-		if (!PreHandleStruct) break;
+	StructInfo->SaveGroup = Group;
 
-		Task.Reset(new FAsyncTask<FStructLoadOrSaveTask>(PreHandleStruct));
-		Task->StartBackgroundTask();
+	if (Group != NAME_None)
+	{
+		SaveGroups.Add(Group, StructInfo);
 	}
-
 }
 
-void UAutoSaveSubsystem::HandleTaskDone()
+void UAutoSaveSubsystem::MarkSaveStructDirty(const FString& Filename)
 {
-	for (TUniquePtr<FAsyncTask<FStructLoadOrSaveTask>>& Task : TaskThreads)
+	if (FSaveStructInfo** Info = StructInfos.Find(Filename))
 	{
-		if (!Task) continue;
-		if (!Task->IsDone()) continue;
-		Task = nullptr;
+		MarkStructDirty(*Info);
 	}
-
-	TArray<FString> StructToRemove;
-
-	for (const TPair<FString, TUniquePtr<FSaveStructInfo>>& Info : StructInfos)
+	else
 	{
-		check(Info.Value);
-
-		if (Info.Value->State != ESaveStructState::Idle) continue;
-
-		if (Info.Value->RefConut <= 0 && Info.Value->LastRefConut <= 0)
-		{
-			StructToRemove.Add(Info.Value->Filename);
-		}
+		UE_LOG(LogAutoSave, Warning, TEXT("Save Struct '%s' is invalid, But was tried to mark dirty."), *Filename);
 	}
+}
 
-	for (const FString& Filename : StructToRemove)
+void UAutoSaveSubsystem::MarkSaveStructDirty(FSaveStructHandle Handle)
+{
+	if (FSaveStructInfo* Info = FindStruct(Handle))
 	{
-		StructInfos.Remove(Filename);
-		ScriptStructHooker.Remove(Filename);
+		MarkStructDirty(Info);
+	}
+	else
+	{
+		UE_LOG(LogAutoSave, Warning, TEXT("Save Struct handle %d is stale, But was tried to mark dirty."), Handle.Index);
+	}
+}
+
+UAutoSaveSubsystem::FStructLoadOrSaveTask::FStructLoadOrSaveTask(UAutoSaveSubsystem* InOwner, FSaveStructInfo * InStructInfoPtr)
+	: Owner(InOwner)
+	, StructInfoPtr(InStructInfoPtr)
+	, bProbe(InStructInfoPtr->State == ESaveStructState::Pending)
+	, bPrefetch(InStructInfoPtr->RefConut <= 0)
+	, bFailed(false)
+	, bCompleted(false)
+	, bFlush(false)
+	, bBatched(false)
+	, bLastInBatch(false)
+	, Priority(InStructInfoPtr->Priority)
+	, RequestTime(InStructInfoPtr->RequestTime)
+	, QueuedCycles(FPlatformTime::Cycles64())
+	, PendingHash(0)
+	, bPendingWrite(false)
+{
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+
+	StructInfoPtr->LastRefConut = StructInfoPtr->RefConut;
+	StructInfoPtr->LastSaveTime = FDateTime::Now();
+
+	switch (StructInfoPtr->State)
+	{
+	// The struct is not accessible while loading, so it is deserialized in place without copying
+	case ESaveStructState::Pending:
+	case ESaveStructState::Preload:
+		StructInfoPtr->State = ESaveStructState::Loading;
+		break;
+
+	case ESaveStructState::Idle:
+	{
+		StructInfoPtr->State = ESaveStructState::Saving;
+		StructInfoPtr->bDirty = false;
+
+		if (Owner->SnapshotBufferPool.Num())
+		{
+			Snapshot = Owner->SnapshotBufferPool.Pop(false);
+		}
+
+		UScriptStruct* Struct = StructInfoPtr->Struct;
+
+		// The only full copy of the struct, deep copied so that the containers are not shared with the game thread
+		Snapshot.SetNumUninitialized(Struct->GetStructureSize(), false);
+		Struct->InitializeStruct(Snapshot.GetData());
+
+		{
+			FRWScopeLock ReadLock(StructInfoPtr->DataLock, SLT_ReadOnly);
+
+			Struct->CopyScriptStruct(Snapshot.GetData(), StructInfoPtr->Data);
+			StructInfoPtr->SnapshotWriteSerial = StructInfoPtr->WriteSerial.GetValue();
+		}
+		break;
+	}
+
+	default: checkNoEntry()
+	}
+
+	Owner->Counters.GameThreadTaskCycles += FPlatformTime::Cycles64() - StartCycles;
+	Owner->Counters.GameThreadTaskNum++;
+}
+
+UAutoSaveSubsystem::FStructLoadOrSaveTask::FStructLoadOrSaveTask(UAutoSaveSubsystem* InOwner, FSaveStructInfo * InStructInfoPtr, TArray<uint8>&& InSnapshot)
+	: Owner(InOwner)
+	, StructInfoPtr(InStructInfoPtr)
+	, bProbe(false)
+	, bPrefetch(false)
+	, bFailed(false)
+	, bCompleted(false)
+	, bFlush(false)
+	, bBatched(false)
+	, bLastInBatch(false)
+	, Priority(InStructInfoPtr->Priority)
+	, RequestTime(InStructInfoPtr->RequestTime)
+	, QueuedCycles(FPlatformTime::Cycles64())
+	, PendingHash(0)
+	, bPendingWrite(false)
+	, Snapshot(MoveTemp(InSnapshot))
+{
+	check(StructInfoPtr->State == ESaveStructState::Snapshotting);
+
+	StructInfoPtr->State = ESaveStructState::Saving;
+}
+
+UAutoSaveSubsystem::FStructLoadOrSaveTask::~FStructLoadOrSaveTask()
+{
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+
+	switch (StructInfoPtr->State)
+	{
+	case ESaveStructState::Loading:
+		// An abandoned load is queued again
+		if (!bCompleted)
+		{
+			StructInfoPtr->State = bProbe ? ESaveStructState::Pending : ESaveStructState::Preload;
+			break;
+		}
+
+		StructInfoPtr->State = bFailed ? ESaveStructState::Failed : ESaveStructState::Idle;
+		break;
+
+	case ESaveStructState::Saving:
+		StructInfoPtr->State = ESaveStructState::Idle;
+
+		// The task was canceled before it ran
+		if (!bCompleted)
+		{
+			StructInfoPtr->Struct->DestroyStruct(Snapshot.GetData());
+		}
+
+		// Keep the struct dirty and referenced, so it is neither skipped nor released before it is saved
+		if (!bCompleted || bFailed)
+		{
+			StructInfoPtr->bDirty = true;
+			StructInfoPtr->LastRefConut = FMath::Max(StructInfoPtr->LastRefConut, 1);
+		}
+
+		Owner->ReleaseSnapshotBuffer(MoveTemp(Snapshot));
+		break;
+
+	default: checkNoEntry()
+	}
+
+	Owner->Counters.GameThreadTaskCycles += FPlatformTime::Cycles64() - StartCycles;
+}
+
+void UAutoSaveSubsystem::FStructLoadOrSaveTask::DoWork()
+{
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+
+	Owner->Counters.QueueWaitLatency.Add(FPlatformTime::ToSeconds64(StartCycles - QueuedCycles));
+
+	switch (StructInfoPtr->State)
+	{
+	case ESaveStructState::Loading:
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(AutoSaveLoadTask);
+		SCOPE_CYCLE_COUNTER(STAT_AutoSaveLoadTask);
+
+		{
+			// The load writes the data in place, scopes held on other threads wait for it
+			FRWScopeLock WriteLock(StructInfoPtr->DataLock, SLT_Write);
+
+			LoadWork();
+		}
+
+		Owner->Counters.LoadNum.Increment();
+		INC_DWORD_STAT(STAT_AutoSaveLoadNum);
+		break;
+	}
+
+	case ESaveStructState::Saving:
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(AutoSaveSaveTask);
+		SCOPE_CYCLE_COUNTER(STAT_AutoSaveSaveTask);
+
+		SaveWork();
+
+		Owner->Counters.SaveNum.Increment();
+		INC_DWORD_STAT(STAT_AutoSaveSaveNum);
+
+		DestroySnapshot();
+		break;
+	}
+
+	default: checkNoEntry()
+	}
+
+	Owner->Counters.SerializeLatency.Add(FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles - IOCycles));
+
+	if (bFailed)
+	{
+		Owner->Counters.FailedNum.Increment();
+	}
+
+	bCompleted = true;
+}
+
+void UAutoSaveSubsystem::FStructLoadOrSaveTask::DestroySnapshot()
+{
+	// Release the containers of the snapshot on the worker thread, the buffer itself returns to the pool later.
+	// A property journal keeps the snapshot as its struct and hands over the previous one instead.
+	if (Snapshot.Num())
+	{
+		StructInfoPtr->Struct->DestroyStruct(Snapshot.GetData());
+	}
+
+	Snapshot.Reset();
+}
+
+void UAutoSaveSubsystem::FStructLoadOrSaveTask::DoThreadedWork()
+{
+	DoWork();
+	PostCompletion();
+}
+
+void UAutoSaveSubsystem::FStructLoadOrSaveTask::Abandon()
+{
+	PostCompletion();
+}
+
+void UAutoSaveSubsystem::FStructLoadOrSaveTask::PostCompletion()
+{
+	// The game thread may delete the task as soon as it is posted
+	FEvent* TaskDoneEvent = Owner->TaskDoneEvent;
+
+	Owner->CompletedTasks.Enqueue(this);
+	TaskDoneEvent->Trigger();
+}
+
+void UAutoSaveSubsystem::FStructLoadOrSaveTask::LoadWork()
+{
+	TArray<uint8> DataBuffer;
+
+	UScriptStruct* Struct = StructInfoPtr->Struct;
+
+	check(Struct);
+
+	if (Owner->Pack)
+	{
+		bool bRead = false;
+
+		{
+			FScopedIO IO(Owner->Counters, IOCycles);
+			bRead = Owner->Pack->Read(StructInfoPtr->Filename, DataBuffer);
+		}
+
+		RecordBytesRead(Owner->Counters, BytesRead, DataBuffer.Num());
+
+		if (!bRead || !FSaveStructFormat::Decode(DataBuffer))
+		{
+			UE_LOG(LogAutoSave, Error, TEXT("Failed to load Save Struct '%s' from the pack."), *StructInfoPtr->Filename);
+			bFailed = true;
+			return;
+		}
+
+		StructInfoPtr->bHasSavedHash = true;
+		StructInfoPtr->SavedHash = CityHash64((const char*)DataBuffer.GetData(), DataBuffer.Num());
+		StructInfoPtr->ImageSize = DataBuffer.Num();
+
+		if (!DeserializeImage(DataBuffer.GetData(), DataBuffer.Num()))
+		{
+			UE_LOG(LogAutoSave, Error, TEXT("Failed to load Save Struct '%s' from the pack."), *StructInfoPtr->Filename);
+			bFailed = true;
+		}
+
+		return;
+	}
+
+	if (bProbe)
+	{
+		FScopedIO IO(Owner->Counters, IOCycles);
+
+		if (!FPaths::FileExists(StructInfoPtr->Filename))
+		{
+			// Check if the target is writable, prefetching leaves no files behind and the first save creates it
+			if (!bPrefetch && !FFileHelper::SaveStringToFile(TEXT(""), *StructInfoPtr->Filename))
+			{
+				UE_LOG(LogAutoSave, Warning, TEXT("Save Struct '%s' is not writable."), *StructInfoPtr->Filename);
+				bFailed = true;
+				return;
+			}
+
+			// Nothing to load, the default struct has to be saved
+			StructInfoPtr->bDirty = true;
+			return;
+		}
+	}
+
+	if (Owner->MappedLoadSize > 0 && LoadMappedWork()) return;
+
+	bool bLoaded = false;
+
+	{
+		FScopedIO IO(Owner->Counters, IOCycles);
+		bLoaded = FFileHelper::LoadFileToArray(DataBuffer, *StructInfoPtr->Filename);
+	}
+
+	RecordBytesRead(Owner->Counters, BytesRead, DataBuffer.Num());
+
+	// The journal belongs to the file as stored, before decoding
+	const uint64 BaseHash = CityHash64((const char*)DataBuffer.GetData(), DataBuffer.Num());
+
+	if (!bLoaded || !FSaveStructFormat::Decode(DataBuffer))
+	{
+		UE_LOG(LogAutoSave, Error, TEXT("Failed to load Save Struct '%s'."), *StructInfoPtr->Filename);
+		bFailed = true;
+		return;
+	}
+
+	TArray<TArray<uint8>> PropertyDeltas;
+	ESaveStructJournalFormat JournalFormat = Owner->JournalFormat;
+
+	// The journal is replayed even if journaled storage is disabled now, otherwise the saves in it are lost
+	StructInfoPtr->JournalBaseHash = BaseHash;
+	StructInfoPtr->JournalBaseSize = DataBuffer.Num();
+
+	{
+		FScopedIO IO(Owner->Counters, IOCycles);
+		StructInfoPtr->JournalSize = FSaveStructJournal::Replay(StructInfoPtr->Filename, BaseHash, DataBuffer, PropertyDeltas, JournalFormat, StructInfoPtr->bJournalAppendable);
+	}
+
+	RecordBytesRead(Owner->Counters, BytesRead, StructInfoPtr->JournalSize);
+
+	// A journal in the other format is compacted by the next save
+	if (JournalFormat != Owner->JournalFormat)
+	{
+		StructInfoPtr->bJournalAppendable = false;
+	}
+
+	// The image no longer describes the struct once property deltas are applied
+	StructInfoPtr->bHasSavedHash = PropertyDeltas.Num() == 0;
+	StructInfoPtr->SavedHash = CityHash64((const char*)DataBuffer.GetData(), DataBuffer.Num());
+	StructInfoPtr->ImageSize = DataBuffer.Num();
+
+	if (!DeserializeImage(DataBuffer.GetData(), DataBuffer.Num()))
+	{
+		UE_LOG(LogAutoSave, Error, TEXT("Failed to load Save Struct '%s'."), *StructInfoPtr->Filename);
+		bFailed = true;
+		return;
+	}
+
+	// Each delta only holds the properties changed since the previous save, the others keep their values
+	for (const TArray<uint8>& PropertyDelta : PropertyDeltas)
+	{
+		FMemoryReader MemoryReader(PropertyDelta);
+
+		Struct->SerializeItem(MemoryReader, StructInfoPtr->Data, nullptr);
+	}
+
+	if (!Owner->bJournaledStorage) return;
+
+	if (Owner->JournalFormat == ESaveStructJournalFormat::Properties)
+	{
+		InitJournalStruct();
+	}
+	else
+	{
+		StructInfoPtr->JournalImage = MoveTemp(DataBuffer);
+	}
+}
+
+bool UAutoSaveSubsystem::FStructLoadOrSaveTask::LoadMappedWork()
+{
+	// The byte journal keeps a copy of the image anyway
+	if (Owner->bJournaledStorage && Owner->JournalFormat == ESaveStructJournalFormat::Bytes) return false;
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+
+	{
+		FScopedIO IO(Owner->Counters, IOCycles);
+
+		const int64 FileSize = PlatformFile.FileSize(*StructInfoPtr->Filename);
+
+		// The hash of the file takes a 32 bit length
+		if (FileSize < Owner->MappedLoadSize || FileSize > MAX_uint32) return false;
+
+		// A journal is replayed onto a copy of the image
+		if (PlatformFile.FileExists(*FSaveStructJournal::GetJournalFilename(StructInfoPtr->Filename))) return false;
+
+		MappedFile.Reset(PlatformFile.OpenMapped(*StructInfoPtr->Filename));
+
+		if (!MappedFile) return false;
+
+		MappedRegion.Reset(MappedFile->MapRegion(0, FileSize, true));
+
+		if (!MappedRegion) return false;
+	}
+
+	// The pages are read while decoding and deserializing, so the time counts as serialization
+	const uint8* FileData = MappedRegion->GetMappedPtr();
+	const int64 FileSize = MappedRegion->GetMappedSize();
+
+	RecordBytesRead(Owner->Counters, BytesRead, FileSize);
+
+	TArray<uint8> Buffer;
+	const uint8* Image = nullptr;
+	int64 ImageSize = 0;
+
+	if (!FSaveStructFormat::Decode(FileData, FileSize, Buffer, Image, ImageSize))
+	{
+		UE_LOG(LogAutoSave, Error, TEXT("Failed to load Save Struct '%s'."), *StructInfoPtr->Filename);
+		bFailed = true;
+		return true;
+	}
+
+	// Without a journal the file as stored is the base of the next one
+	StructInfoPtr->JournalBaseHash = CityHash64((const char*)FileData, (uint32)FileSize);
+	StructInfoPtr->JournalBaseSize = FileSize;
+	StructInfoPtr->JournalSize = 0;
+	StructInfoPtr->bJournalAppendable = true;
+
+	StructInfoPtr->bHasSavedHash = true;
+	StructInfoPtr->SavedHash = Image == FileData ? StructInfoPtr->JournalBaseHash : CityHash64((const char*)Image, (uint32)ImageSize);
+	StructInfoPtr->ImageSize = ImageSize;
+
+	if (!DeserializeImage(Image, ImageSize))
+	{
+		UE_LOG(LogAutoSave, Error, TEXT("Failed to load Save Struct '%s'."), *StructInfoPtr->Filename);
+		bFailed = true;
+		return true;
+	}
+
+	if (Owner->bJournaledStorage)
+	{
+		InitJournalStruct();
+	}
+
+	return true;
+}
+
+void UAutoSaveSubsystem::FStructLoadOrSaveTask::InitJournalStruct()
+{
+	UScriptStruct* Struct = StructInfoPtr->Struct;
+
+	StructInfoPtr->JournalStruct.SetNumUninitialized(Struct->GetStructureSize());
+	Struct->InitializeStruct(StructInfoPtr->JournalStruct.GetData());
+	Struct->CopyScriptStruct(StructInfoPtr->JournalStruct.GetData(), StructInfoPtr->Data);
+}
+
+void UAutoSaveSubsystem::FStructLoadOrSaveTask::SaveWork()
+{
+	if (Owner->bJournaledStorage && Owner->JournalFormat == ESaveStructJournalFormat::Properties && !Owner->Pack)
+	{
+		SavePropertyJournaled();
+		return;
+	}
+
+	// A stream can only be seeked back while it is raw
+	if (Owner->StreamingSaveSize > 0 && StructInfoPtr->ImageSize >= Owner->StreamingSaveSize && !Owner->bJournaledStorage && !Owner->Pack
+		&& (StructInfoPtr->Plan || !FSaveStructFormat::IsCompressionAvailable(StructInfoPtr->Compression)))
+	{
+		SaveStreamed();
+		return;
+	}
+
+	TArray<uint8> DataBuffer;
+
+	if (!SerializeSave(DataBuffer)) return;
+
+	if (Owner->bJournaledStorage && !Owner->Pack)
+	{
+		SaveJournaled(DataBuffer, PendingHash);
+
+		if (bFailed) return;
+
+		StructInfoPtr->bHasSavedHash = true;
+		StructInfoPtr->SavedHash = PendingHash;
+		return;
+	}
+
+	FSaveStructFormat::Encode(DataBuffer, StructInfoPtr->Compression, PendingFile);
+
+	bool bSuccessful = false;
+
+	{
+		FScopedIO IO(Owner->Counters, IOCycles);
+
+		// Records of the pack are rewritten as a whole, the pack reuses the freed space
+		bSuccessful = Owner->Pack
+			? Owner->Pack->Write(StructInfoPtr->Filename, PendingFile, Owner->bDurableSaves)
+			: WriteFile(StructInfoPtr->Filename, PendingFile, Owner->bDurableSaves);
+	}
+
+	RecordBytesWritten(Owner->Counters, BytesWritten, PendingFile.Num());
+
+	FinishWrite(bSuccessful);
+}
+
+void UAutoSaveSubsystem::FStructLoadOrSaveTask::SaveStreamed()
+{
+	check(StructInfoPtr->Struct);
+
+	bool bSuccessful = false;
+	int64 FileSize = 0;
+
+	{
+		FSaveStructStreamWriter Writer(StructInfoPtr->Filename, StructInfoPtr->Compression, Owner->StreamingChunkSize);
+
+		// The chunks are written while serializing, so that time counts as serialization
+		SerializeImage(Snapshot.GetData(), Writer);
+
+		StructInfoPtr->ImageSize = Writer.TotalSize();
+
+		{
+			FScopedIO IO(Owner->Counters, IOCycles);
+			bSuccessful = Writer.Commit(Owner->bDurableSaves);
+		}
+
+		FileSize = Writer.GetFileSize();
+	}
+
+	RecordBytesWritten(Owner->Counters, BytesWritten, FileSize);
+
+#if DO_GUARD_SLOW
+	if (bSuccessful)
+	{
+		VerifyStreamedSave();
+	}
+#endif
+
+	FinishWrite(bSuccessful);
+
+	StructInfoPtr->bHasSavedHash = false;
+}
+
+#if DO_GUARD_SLOW
+void UAutoSaveSubsystem::FStructLoadOrSaveTask::VerifyStreamedSave() const
+{
+	UScriptStruct* Struct = StructInfoPtr->Struct;
+
+	TArray<uint8> DataBuffer;
+
+	const bool bDecoded = FFileHelper::LoadFileToArray(DataBuffer, *StructInfoPtr->Filename) && FSaveStructFormat::Decode(DataBuffer);
+
+	checkfSlow(bDecoded, TEXT("Failed to read back the streamed Save Struct '%s'."), *StructInfoPtr->Filename);
+
+	TArray<uint8> LoadedData;
+	LoadedData.SetNumUninitialized(Struct->GetStructureSize());
+	Struct->InitializeStruct(LoadedData.GetData());
+
+	const bool bEqual = bDecoded && DeserializeImage(DataBuffer.GetData(), DataBuffer.Num(), LoadedData.GetData())
+		&& Struct->CompareScriptStruct(LoadedData.GetData(), Snapshot.GetData(), PPF_None);
+
+	Struct->DestroyStruct(LoadedData.GetData());
+
+	checkfSlow(bEqual, TEXT("The streamed Save Struct '%s' does not load back equal to its snapshot."), *StructInfoPtr->Filename);
+}
+#endif
+
+bool UAutoSaveSubsystem::FStructLoadOrSaveTask::SerializeSave(TArray<uint8>& OutDataBuffer)
+{
+	check(StructInfoPtr->Struct);
+
+	SerializeImage(Snapshot.GetData(), OutDataBuffer);
+
+	PendingHash = CityHash64((const char*)OutDataBuffer.GetData(), OutDataBuffer.Num());
+
+	StructInfoPtr->ImageSize = OutDataBuffer.Num();
+
+	// The file already holds the same image
+	if (StructInfoPtr->bHasSavedHash && StructInfoPtr->SavedHash == PendingHash)
+	{
+		Owner->Counters.UnchangedSaveNum.Increment();
+		return false;
+	}
+
+	return true;
+}
+
+void UAutoSaveSubsystem::FStructLoadOrSaveTask::FinishWrite(bool bSuccessful)
+{
+	PendingFile.Empty();
+
+	if (!bSuccessful)
+	{
+		UE_LOG(LogAutoSave, Error, TEXT("Failed to save Save Struct '%s'."), *StructInfoPtr->Filename);
+		bFailed = true;
+		return;
+	}
+
+	// A journal left by journaled storage would be replayed onto the new file
+	if (StructInfoPtr->JournalSize)
+	{
+		FScopedIO IO(Owner->Counters, IOCycles);
+		FSaveStructJournal::Discard(StructInfoPtr->Filename);
+		StructInfoPtr->JournalSize = 0;
+	}
+
+	StructInfoPtr->bJournalAppendable = false;
+
+	StructInfoPtr->bHasSavedHash = true;
+	StructInfoPtr->SavedHash = PendingHash;
+
+	// A property journal goes on from the struct as written, the previous one is destroyed with the snapshot
+	if (StructInfoPtr->JournalStruct.Num() && Snapshot.Num())
+	{
+		Swap(StructInfoPtr->JournalStruct, Snapshot);
+	}
+
+	StructInfoPtr->JournalImage.Empty();
+}
+
+void UAutoSaveSubsystem::FStructLoadOrSaveTask::PrepareBatchedSave()
+{
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+
+	Owner->Counters.QueueWaitLatency.Add(FPlatformTime::ToSeconds64(StartCycles - QueuedCycles));
+
+	TArray<uint8> DataBuffer;
+
+	if (SerializeSave(DataBuffer))
+	{
+		FSaveStructFormat::Encode(DataBuffer, StructInfoPtr->Compression, PendingFile);
+		bPendingWrite = true;
+	}
+
+	// The snapshot becomes the journal struct once written
+	if (!bPendingWrite || !StructInfoPtr->JournalStruct.Num())
+	{
+		DestroySnapshot();
+	}
+
+	Owner->Counters.SerializeLatency.Add(FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles));
+}
+
+void UAutoSaveSubsystem::FStructLoadOrSaveTask::FinishBatchedSave()
+{
+	DestroySnapshot();
+
+	Owner->Counters.SaveNum.Increment();
+	INC_DWORD_STAT(STAT_AutoSaveSaveNum);
+
+	if (bFailed)
+	{
+		Owner->Counters.FailedNum.Increment();
+	}
+
+	bCompleted = true;
+}
+
+void UAutoSaveSubsystem::FStructLoadOrSaveTask::SerializeImage(const uint8* StructData, TArray<uint8>& OutImage) const
+{
+	FMemoryWriter MemoryWriter(OutImage);
+
+	SerializeImage(StructData, MemoryWriter);
+}
+
+void UAutoSaveSubsystem::FStructLoadOrSaveTask::SerializeImage(const uint8* StructData, FArchive& Writer) const
+{
+	if (StructInfoPtr->Plan)
+	{
+		StructInfoPtr->Plan->Serialize(StructData, Writer);
+		return;
+	}
+
+	StructInfoPtr->Struct->SerializeItem(Writer, const_cast<uint8*>(StructData), nullptr);
+}
+
+bool UAutoSaveSubsystem::FStructLoadOrSaveTask::DeserializeImage(const uint8* Image, int64 ImageSize)
+{
+	return DeserializeImage(Image, ImageSize, StructInfoPtr->Data);
+}
+
+bool UAutoSaveSubsystem::FStructLoadOrSaveTask::DeserializeImage(const uint8* Image, int64 ImageSize, uint8* OutData) const
+{
+	// Planned images are read without the plan as well, the setting may have changed since they were written
+	if (FSaveStructPlan::IsPlanImage(Image, ImageSize))
+	{
+		return FSaveStructPlan::Deserialize(StructInfoPtr->Plan.Get(), StructInfoPtr->Struct, Image, ImageSize, OutData);
+	}
+
+	// An empty file holds the default struct
+	if (!ImageSize) return true;
+
+	FLargeMemoryReader MemoryReader(Image, ImageSize);
+
+	StructInfoPtr->Struct->SerializeItem(MemoryReader, OutData, nullptr);
+
+	return true;
+}
+
+void UAutoSaveSubsystem::FStructLoadOrSaveTask::SaveJournaled(TArray<uint8>& DataBuffer, uint64 DataHash)
+{
+	bool bCompact = !StructInfoPtr->bJournalAppendable;
+
+	TArray<uint8> Payload;
+
+	if (!bCompact)
+	{
+		FSaveStructJournal::MakeDelta(StructInfoPtr->JournalImage, DataBuffer, Payload);
+
+		// Compact when the delta is not much smaller than the image, or the journal has grown too large
+		bCompact = Payload.Num() > DataBuffer.Num() / 2
+			|| StructInfoPtr->JournalSize + Payload.Num() > StructInfoPtr->JournalBaseSize * Owner->JournalCompactionRatio;
+	}
+
+	if (!bCompact && AppendJournal(ESaveStructJournalFormat::Bytes, Payload))
+	{
+		StructInfoPtr->JournalImage = MoveTemp(DataBuffer);
+		return;
+	}
+
+	if (!CompactJournal(DataBuffer)) return;
+
+	StructInfoPtr->JournalImage = MoveTemp(DataBuffer);
+}
+
+void UAutoSaveSubsystem::FStructLoadOrSaveTask::SavePropertyJournaled()
+{
+	UScriptStruct* Struct = StructInfoPtr->Struct;
+
+	const bool bHasJournalStruct = StructInfoPtr->JournalStruct.Num() > 0;
+
+	bool bCompact = !StructInfoPtr->bJournalAppendable || !bHasJournalStruct;
+
+	// Nothing has changed since the last save, compared without serializing, a file that cannot be appended to is rewritten anyway
+	if (!bCompact && Struct->CompareScriptStruct(StructInfoPtr->JournalStruct.GetData(), Snapshot.GetData(), PPF_None))
+	{
+		Owner->Counters.UnchangedSaveNum.Increment();
+		return;
+	}
+
+	if (!bCompact)
+	{
+		TArray<uint8> Payload;
+		FMemoryWriter MemoryWriter(Payload);
+
+		// Only the properties that differ from the persisted struct are serialized
+		Struct->SerializeItem(MemoryWriter, Snapshot.GetData(), StructInfoPtr->JournalStruct.GetData());
+
+		// Compact when the delta is not much smaller than the file, or the journal has grown too large
+		bCompact = Payload.Num() > StructInfoPtr->JournalBaseSize / 2
+			|| StructInfoPtr->JournalSize + Payload.Num() > StructInfoPtr->JournalBaseSize * Owner->JournalCompactionRatio;
+
+		if (!bCompact && AppendJournal(ESaveStructJournalFormat::Properties, Payload))
+		{
+			StructInfoPtr->bHasSavedHash = false;
+			Swap(StructInfoPtr->JournalStruct, Snapshot);
+			return;
+		}
+	}
+
+	TArray<uint8> DataBuffer;
+	SerializeImage(Snapshot.GetData(), DataBuffer);
+
+	StructInfoPtr->ImageSize = DataBuffer.Num();
+
+	if (!CompactJournal(DataBuffer)) return;
+
+	StructInfoPtr->bHasSavedHash = true;
+	StructInfoPtr->SavedHash = CityHash64((const char*)DataBuffer.GetData(), DataBuffer.Num());
+	StructInfoPtr->JournalImage.Empty();
+
+	// The snapshot becomes the persisted struct, the previous one is destroyed in its place
+	Swap(StructInfoPtr->JournalStruct, Snapshot);
+}
+
+bool UAutoSaveSubsystem::FStructLoadOrSaveTask::CompactJournal(const TArray<uint8>& DataBuffer)
+{
+	TArray<uint8> FileBuffer;
+	FSaveStructFormat::Encode(DataBuffer, StructInfoPtr->Compression, FileBuffer);
+
+	bool bSuccessful = false;
+
+	{
+		FScopedIO IO(Owner->Counters, IOCycles);
+		bSuccessful = FSaveStructJournal::Compact(StructInfoPtr->Filename, FileBuffer, Owner->bDurableSaves);
+	}
+
+	RecordBytesWritten(Owner->Counters, BytesWritten, FileBuffer.Num());
+
+	if (!bSuccessful)
+	{
+		UE_LOG(LogAutoSave, Error, TEXT("Failed to save Save Struct '%s'."), *StructInfoPtr->Filename);
+		bFailed = true;
+		return false;
+	}
+
+	StructInfoPtr->JournalBaseHash = CityHash64((const char*)FileBuffer.GetData(), FileBuffer.Num());
+	StructInfoPtr->JournalBaseSize = DataBuffer.Num();
+	StructInfoPtr->JournalSize = 0;
+	StructInfoPtr->bJournalAppendable = true;
+
+	return true;
+}
+
+bool UAutoSaveSubsystem::FStructLoadOrSaveTask::AppendJournal(ESaveStructJournalFormat Format, const TArray<uint8>& Payload)
+{
+	FScopedIO IO(Owner->Counters, IOCycles);
+
+	RecordBytesWritten(Owner->Counters, BytesWritten, Payload.Num());
+
+	return FSaveStructJournal::Append(StructInfoPtr->Filename, StructInfoPtr->JournalBaseHash, Format, Payload, StructInfoPtr->JournalSize, Owner->bDurableSaves);
+}
+
+TArray<FString> UAutoSaveSubsystem::FlushSaveStructs(FTimespan Deadline)
+{
+	return FlushStructs(INDEX_NONE, Deadline);
+}
+
+TArray<FString> UAutoSaveSubsystem::FlushStructs(int32 PartitionIndex, FTimespan Deadline)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AutoSaveFlush);
+
+	// Nothing is left after Deinitialize
+	if (!Partitions.Num()) return TArray<FString>();
+
+	// Make sure the tasks are completed, the unfinished snapshots are taken again at once
+	AbortSnapshots(PartitionIndex);
+	WaitForTasks(PartitionIndex);
+
+	TArray<FSaveStructInfo*> StructsToFlush;
+
+	auto AddStructToFlush = [this, &StructsToFlush](FSaveStructInfo* Info)
+	{
+		// Skip objects that are not loaded
+		if (!Info->IsLoaded()) return;
+
+		check(Info->State == ESaveStructState::Idle);
+
+		if (IsCleanStruct(Info)) return;
+
+		StructsToFlush.Add(Info);
+	};
+
+	if (PartitionIndex == INDEX_NONE)
+	{
+		for (const TPair<FString, FSaveStructInfo*>& Info : StructInfos)
+		{
+			AddStructToFlush(Info.Value);
+		}
+	}
+	else
+	{
+		for (FSaveStructInfo* Info : Partitions[PartitionIndex]->Members)
+		{
+			AddStructToFlush(Info);
+		}
+	}
+
+	// The structs that have gone unsaved the longest come first
+	StructsToFlush.Sort([](const FSaveStructInfo& A, const FSaveStructInfo& B) { return A.LastSaveTime < B.LastSaveTime; });
+
+	// Members of a group are committed together, they are waited for regardless of the deadline
+	TMap<FName, TArray<FSaveStructInfo*>> GroupsToFlush;
+
+	StructsToFlush.RemoveAll([&GroupsToFlush](FSaveStructInfo* Info)
+	{
+		if (Info->SaveGroup == NAME_None) return false;
+
+		GroupsToFlush.FindOrAdd(Info->SaveGroup).Add(Info);
+		return true;
+	});
+
+	double EndTime = Deadline > FTimespan::Zero() ? FPlatformTime::Seconds() + Deadline.GetTotalSeconds() : 0.0;
+
+	TArray<FString> UnsavedStructs;
+
+	if (!TaskPool)
+	{
+		for (const TPair<FName, TArray<FSaveStructInfo*>>& Group : GroupsToFlush)
+		{
+			RunSaveBatch(Group.Value, true);
+		}
+
+		for (FSaveStructInfo* Info : StructsToFlush)
+		{
+			if (EndTime && FPlatformTime::Seconds() > EndTime)
+			{
+				UnsavedStructs.Add(Info->Filename);
+				continue;
+			}
+
+			{
+				FStructLoadOrSaveTask Task(this, Info);
+				Task.DoWork();
+			}
+
+			ScheduleStruct(Info);
+		}
+	}
+	else
+	{
+		for (const TPair<FName, TArray<FSaveStructInfo*>>& Group : GroupsToFlush)
+		{
+			StartSaveBatch(Group.Value, true);
+		}
+
+		// The pool spreads the saves across all of its workers in this order
+		for (FSaveStructInfo* Info : StructsToFlush)
+		{
+			StartTask(Info, true);
+		}
+
+		while (FlushTasks.Num())
+		{
+			HandleTaskDone();
+
+			if (!FlushTasks.Num()) break;
+
+			if (!EndTime)
+			{
+				TaskDoneEvent->Wait();
+				continue;
+			}
+
+			const double RemainingTime = EndTime - FPlatformTime::Seconds();
+
+			if (RemainingTime > 0.0)
+			{
+				TaskDoneEvent->Wait((uint32)FMath::CeilToInt(RemainingTime * 1000.0));
+				continue;
+			}
+
+			// Saves that have started cannot be abandoned halfway, only the queued ones are dropped, batched tasks are not in the queue on their own
+			for (TSet<FStructLoadOrSaveTask*>::TIterator It = FlushTasks.CreateIterator(); It; ++It)
+			{
+				FStructLoadOrSaveTask* Task = *It;
+
+				if (!TaskPool->RetractQueuedWork(Task)) continue;
+
+				FSaveStructInfo* Info = Task->StructInfoPtr;
+
+				UnsavedStructs.Add(Info->Filename);
+
+				It.RemoveCurrent();
+				delete Task;
+				--InFlightTaskNum;
+				--GetPartition(Info).InFlightTaskNum;
+
+				ScheduleStruct(Info);
+			}
+
+			// Wait for the running saves without the deadline
+			EndTime = 0.0;
+		}
+	}
+
+	for (const FString& Filename : UnsavedStructs)
+	{
+		UE_LOG(LogAutoSave, Error, TEXT("Save Struct '%s' was not saved before the flush deadline."), *Filename);
+	}
+
+	if (UnsavedStructs.Num())
+	{
+		UE_LOG(LogAutoSave, Error, TEXT("Flushed %d of %d Save Structs before the deadline."), StructsToFlush.Num() - UnsavedStructs.Num(), StructsToFlush.Num());
+	}
+
+	return UnsavedStructs;
+}
+
+void UAutoSaveSubsystem::AddSaveStructPartition(FName Partition, const FString& RootDirectory, int32 MaxInFlightTaskNum)
+{
+	if (bDeinitialized)
+	{
+		UE_LOG(LogAutoSave, Warning, TEXT("The subsystem is deinitialized, But Save Struct partition '%s' was tried to add."), *Partition.ToString());
+		return;
+	}
+
+	if (Partition == NAME_None || RootDirectory.IsEmpty())
+	{
+		UE_LOG(LogAutoSave, Warning, TEXT("Save Struct partitions need a name and a root directory."));
+		return;
+	}
+
+	FString Root = RootDirectory;
+	FPaths::NormalizeDirectoryName(Root);
+
+	const int32 PartitionIndex = FindPartition(Partition);
+
+	if (PartitionIndex != INDEX_NONE)
+	{
+		if (Partitions[PartitionIndex]->RootDirectory != Root)
+		{
+			UE_LOG(LogAutoSave, Warning, TEXT("Save Struct partition '%s' already has the root '%s'."), *Partition.ToString(), *Partitions[PartitionIndex]->RootDirectory);
+			return;
+		}
+
+		Partitions[PartitionIndex]->MaxInFlightTaskNum = MaxInFlightTaskNum;
+		return;
+	}
+
+	if (PartitionRoots.Contains(Root))
+	{
+		UE_LOG(LogAutoSave, Warning, TEXT("The root '%s' already belongs to another Save Struct partition."), *Root);
+		return;
+	}
+
+	TUniquePtr<FSaveStructPartition> NewPartition = MakeUnique<FSaveStructPartition>();
+	NewPartition->Name = Partition;
+	NewPartition->RootDirectory = Root;
+	NewPartition->MaxInFlightTaskNum = MaxInFlightTaskNum;
+
+	PartitionRoots.Add(Root, Partitions.Add(MoveTemp(NewPartition)));
+}
+
+TArray<FString> UAutoSaveSubsystem::FlushSaveStructPartition(FName Partition, FTimespan Deadline)
+{
+	const int32 PartitionIndex = FindPartition(Partition);
+
+	if (PartitionIndex == INDEX_NONE)
+	{
+		UE_LOG(LogAutoSave, Warning, TEXT("Save Struct partition '%s' is invalid, But was tried to flush."), *Partition.ToString());
+		return TArray<FString>();
+	}
+
+	return FlushStructs(PartitionIndex, Deadline);
+}
+
+TArray<FString> UAutoSaveSubsystem::UnloadSaveStructPartition(FName Partition, FTimespan Deadline)
+{
+	const int32 PartitionIndex = FindPartition(Partition);
+
+	if (PartitionIndex == INDEX_NONE)
+	{
+		UE_LOG(LogAutoSave, Warning, TEXT("Save Struct partition '%s' is invalid, But was tried to unload."), *Partition.ToString());
+		return TArray<FString>();
+	}
+
+	TArray<FString> UnsavedStructs = FlushStructs(PartitionIndex, Deadline);
+
+	// Removing a struct moves the last member into its place
+	TArray<FSaveStructInfo*> Members = Partitions[PartitionIndex]->Members;
+
+	for (FSaveStructInfo* Info : Members)
+	{
+		if (Info->RefConut > 0)
+		{
+			UE_LOG(LogAutoSave, Warning, TEXT("Save Struct '%s' still has references, it is kept when unloading the partition."), *Info->Filename);
+			continue;
+		}
+
+		// Missed the deadline or failed to save, the scheduler saves and releases it later
+		if (Info->IsLoaded() && Info->bDirty) continue;
+
+		if (Info->ResidentNode)
+		{
+			ResidentSize -= Info->ResidentSize;
+			ResidentList.RemoveNode(Info->ResidentNode);
+			Info->ResidentNode = nullptr;
+		}
+
+		RemoveStructInfo(Info);
+	}
+
+	if (Partitions[PartitionIndex]->Members.Num()) return UnsavedStructs;
+
+	// The last partition takes the place of the removed one
+	PartitionRoots.Remove(Partitions[PartitionIndex]->RootDirectory);
+
+	Partitions.RemoveAtSwap(PartitionIndex);
+
+	if (Partitions.IsValidIndex(PartitionIndex))
+	{
+		PartitionRoots.Add(Partitions[PartitionIndex]->RootDirectory, PartitionIndex);
+
+		for (FSaveStructInfo* Info : Partitions[PartitionIndex]->Members)
+		{
+			Info->PartitionIndex = PartitionIndex;
+		}
+	}
+
+	PartitionCursor = 0;
+
+	return UnsavedStructs;
+}
+
+int32 UAutoSaveSubsystem::GetSaveStructPartitionStructNum(FName Partition) const
+{
+	const int32 PartitionIndex = FindPartition(Partition);
+
+	return PartitionIndex != INDEX_NONE ? Partitions[PartitionIndex]->Members.Num() : 0;
+}
+
+int32 UAutoSaveSubsystem::GetQueuedTaskNum() const
+{
+	int32 Result = 0;
+
+	for (const TUniquePtr<FSaveStructPartition>& Partition : Partitions)
+	{
+		Result += Partition->QueuedEntryNum + Partition->PrefetchHeap.Num() + Partition->DueHeap.Num() + Partition->DueQueueNum;
+	}
+
+	return Result;
+}
+
+int32 UAutoSaveSubsystem::FindPartition(FName Partition) const
+{
+	// The default partition has no name and cannot be looked up
+	for (int32 PartitionIndex = 1; PartitionIndex < Partitions.Num(); ++PartitionIndex)
+	{
+		if (Partitions[PartitionIndex]->Name == Partition) return PartitionIndex;
+	}
+
+	return INDEX_NONE;
+}
+
+int32 UAutoSaveSubsystem::FindFilePartition(const FString& Filename) const
+{
+	if (!PartitionRoots.Num()) return 0;
+
+	FString Path = FPaths::GetPath(Filename);
+	FPaths::NormalizeDirectoryName(Path);
+
+	while (!Path.IsEmpty())
+	{
+		if (const int32* PartitionIndex = PartitionRoots.Find(Path)) return *PartitionIndex;
+
+		Path = FPaths::GetPath(Path);
+	}
+
+	return 0;
+}
+
+void UAutoSaveSubsystem::ScheduleStruct(FSaveStructInfo* Info)
+{
+	FSaveStructPartition& Partition = GetPartition(Info);
+
+	switch (Info->State)
+	{
+	case ESaveStructState::Pending:
+	case ESaveStructState::Preload:
+		Info->RequestTime = FDateTime::Now();
+
+		// Only prefetched structs are loaded without references, they wait for the demand loads
+		if (Info->RefConut <= 0)
+		{
+			Info->Priority = ESaveStructPriority::PrefetchLoad;
+			Partition.PrefetchHeap.HeapPush(FStructPrefetchEntry{ Info->PrefetchPriority, PrefetchSequence++, Info->Handle });
+		}
+		else if (Info->Priority == ESaveStructPriority::CriticalLoad)
+		{
+			Partition.CriticalLoadQueue.Enqueue(Info->Handle);
+			++Partition.QueuedEntryNum;
+		}
+		else
+		{
+			Info->Priority = ESaveStructPriority::NormalLoad;
+			Partition.LoadQueue.Enqueue(Info->Handle);
+			++Partition.QueuedEntryNum;
+		}
+		break;
+
+	case ESaveStructState::Failed:
+		if (Info->RefConut <= 0)
+		{
+			Partition.ReleaseQueue.Enqueue(Info->Handle);
+			++Partition.QueuedEntryNum;
+			++Partition.ReleaseEntryNum;
+		}
+		break;
+
+	case ESaveStructState::Idle:
+		if (Info->RefConut <= 0)
+		{
+			Info->Priority = ESaveStructPriority::ReleaseSave;
+			Info->RequestTime = FDateTime::Now();
+			Partition.ReleaseQueue.Enqueue(Info->Handle);
+			++Partition.QueuedEntryNum;
+			++Partition.ReleaseEntryNum;
+		}
+		else
+		{
+			// The request time is the due time, it is only known once the struct is due
+			Info->Priority = ESaveStructPriority::BackgroundSave;
+
+			Partition.DueHeap.HeapPush(FStructDueEntry{ Info->LastSaveTime, Info->Handle });
+		}
+		break;
+
+	// Loading and Saving structs are scheduled again when the task is done
+	default: break;
+	}
+}
+
+void UAutoSaveSubsystem::ReleaseStruct(FSaveStructInfo* Info)
+{
+	if (Info->ResidentNode) return;
+
+	// The data is on disk, keep it in memory in case the struct is acquired again soon
+	if (Info->State == ESaveStructState::Idle && ResidentCacheBudget > 0)
+	{
+		ResidentList.AddHead(Info);
+
+		Info->ResidentNode = ResidentList.GetHead();
+		Info->ResidentSize = Info->Struct->GetStructureSize() + Info->ImageSize;
+
+		ResidentSize += Info->ResidentSize;
+
+		while (ResidentSize > ResidentCacheBudget)
+		{
+			EvictResidentStruct();
+		}
+
+		return;
+	}
+
+	RemoveStructInfo(Info);
+}
+
+void UAutoSaveSubsystem::EvictResidentStruct()
+{
+	TDoubleLinkedList<FSaveStructInfo*>::TDoubleLinkedListNode* Node = ResidentList.GetTail();
+
+	check(Node);
+
+	FSaveStructInfo* Info = Node->GetValue();
+
+	ResidentSize -= Info->ResidentSize;
+	ResidentList.RemoveNode(Node);
+	Info->ResidentNode = nullptr;
+
+	RemoveStructInfo(Info);
+}
+
+void UAutoSaveSubsystem::RemoveStructInfo(FSaveStructInfo* Info)
+{
+	if (Info->SaveGroup != NAME_None)
+	{
+		SaveGroups.RemoveSingle(Info->SaveGroup, Info);
+	}
+
+	const int32 SlotIndex = Info->Handle.Index;
+
+	Slots[SlotIndex].Info = nullptr;
+	Slots[SlotIndex].Generation++;
+	FreeSlots.Add(SlotIndex);
+
+	ScriptStructHooker[SlotIndex] = nullptr;
+
+	StructInfos.Remove(Info->Filename);
+
+	TArray<FSaveStructInfo*>& Members = GetPartition(Info).Members;
+
+	Members.RemoveAtSwap(Info->PartitionMemberIndex, 1, false);
+
+	if (Members.IsValidIndex(Info->PartitionMemberIndex))
+	{
+		Members[Info->PartitionMemberIndex]->PartitionMemberIndex = Info->PartitionMemberIndex;
+	}
+
+	DestroyStructInfo(Info);
+}
+
+void UAutoSaveSubsystem::DestroyStructInfo(FSaveStructInfo* Info)
+{
+	Info->Struct->DestroyStruct(Info->Data);
+	PayloadAllocator->Free(Info->Data, Info->DataSize, Info->DataAlignment);
+
+	InfoPool->Free(Info);
+}
+
+FSaveStructInfo* UAutoSaveSubsystem::FindPreHandleStruct(FSaveStructPartition& Partition, const FDateTime& NowTime, bool bDemandLoadsOnly, bool bSkipSaves, bool bSkipLoads)
+{
+	FSaveStructHandle Handle;
+
+	for (TQueue<FSaveStructHandle>* Queue : { &Partition.CriticalLoadQueue, &Partition.LoadQueue })
+	{
+		if (bSkipLoads && Queue == &Partition.LoadQueue) break;
+
+		while (Queue->Dequeue(Handle))
+		{
+			--Partition.QueuedEntryNum;
+
+			FSaveStructInfo* PreHandleStruct = FindStruct(Handle);
+
+			if (!PreHandleStruct) continue;
+
+			// Raising the class leaves the old entry behind, and prefetched structs are queued again when acquired
+			if (PreHandleStruct->RefConut <= 0) continue;
+
+			if (PreHandleStruct->State == ESaveStructState::Pending || PreHandleStruct->State == ESaveStructState::Preload) return PreHandleStruct;
+		}
+	}
+
+	if (bDemandLoadsOnly) return nullptr;
+
+	if (!bSkipSaves)
+	{
+		if (FSaveStructInfo* PreHandleStruct = FindReleasedStruct(Partition)) return PreHandleStruct;
+	}
+
+	while (Partition.PrefetchHeap.Num() && !bSkipLoads)
+	{
+		FStructPrefetchEntry Entry;
+		Partition.PrefetchHeap.HeapPop(Entry, false);
+
+		FSaveStructInfo* PreHandleStruct = FindStruct(Entry.Handle);
+
+		if (!PreHandleStruct) continue;
+
+		if (PreHandleStruct->State == ESaveStructState::Pending || PreHandleStruct->State == ESaveStructState::Preload) return PreHandleStruct;
+	}
+
+	return bSkipSaves ? nullptr : FindDueStruct(Partition);
+}
+
+FSaveStructInfo* UAutoSaveSubsystem::FindReleasedStruct(FSaveStructPartition& Partition, bool bBatchableOnly)
+{
+	FSaveStructHandle Handle;
+
+	while (Partition.ReleaseQueue.Peek(Handle))
+	{
+		FSaveStructInfo* PreHandleStruct = FindStruct(Handle);
+
+		if (bBatchableOnly && PreHandleStruct && PreHandleStruct->State == ESaveStructState::Idle && !CanJoinSaveBatch(PreHandleStruct)) return nullptr;
+
+		Partition.ReleaseQueue.Pop();
+		--Partition.QueuedEntryNum;
+		--Partition.ReleaseEntryNum;
+
+		if (!PreHandleStruct) continue;
+
+		if (PreHandleStruct->State != ESaveStructState::Idle && PreHandleStruct->State != ESaveStructState::Failed) continue;
+
+		if (PreHandleStruct->RefConut > 0) continue;
+
+		// Structs that have been saved with no references are no longer needed, failed structs are never saved
+		if (PreHandleStruct->State == ESaveStructState::Failed || PreHandleStruct->LastRefConut <= 0 || IsCleanStruct(PreHandleStruct))
+		{
+			ReleaseStruct(PreHandleStruct);
+			continue;
+		}
+
+		return PreHandleStruct;
+	}
+
+	return nullptr;
+}
+
+FSaveStructInfo* UAutoSaveSubsystem::FindDueStruct(FSaveStructPartition& Partition, bool bBatchableOnly)
+{
+	FStructDueEntry Entry;
+
+	while (Partition.DueQueue.Peek(Entry))
+	{
+		FSaveStructInfo* PreHandleStruct = FindStruct(Entry.Handle);
+
+		// The struct has been handled since the entry was pushed
+		const bool bStale = !PreHandleStruct || PreHandleStruct->State != ESaveStructState::Idle || PreHandleStruct->LastSaveTime != Entry.LastSaveTime;
+
+		if (bBatchableOnly && !bStale && !CanJoinSaveBatch(PreHandleStruct)) return nullptr;
+
+		Partition.DueQueue.Pop();
+		--Partition.DueQueueNum;
+
+		if (bStale) continue;
+
+		PreHandleStruct->RequestTime = Entry.LastSaveTime + SaveWaitTime;
+
+		return PreHandleStruct;
+	}
+
+	return nullptr;
+}
+
+void UAutoSaveSubsystem::MaintainPartition(FSaveStructPartition& Partition, const FDateTime& NowTime)
+{
+	TArray<FStructDueEntry>& DueHeap = Partition.DueHeap;
+
+	// Released structs leave stale entries behind, drop them before they pile up
+	if (DueHeap.Num() > Partition.Members.Num() * 2 + 64)
+	{
+		DueHeap.RemoveAll([this](const FStructDueEntry& Entry)
+		{
+			const FSaveStructInfo* EntryInfo = FindStruct(Entry.Handle);
+			return !EntryInfo || EntryInfo->State != ESaveStructState::Idle || EntryInfo->LastSaveTime != Entry.LastSaveTime;
+		});
+
+		DueHeap.Heapify();
+	}
+
+	TArray<FStructDueEntry, TInlineAllocator<16>> CleanEntries;
+
+	while (DueHeap.Num() && NowTime - DueHeap.HeapTop().LastSaveTime > SaveWaitTime)
+	{
+		FStructDueEntry Entry;
+		DueHeap.HeapPop(Entry, false);
+
+		FSaveStructInfo* Info = FindStruct(Entry.Handle);
+
+		if (!Info) continue;
+
+		// The struct has been handled since the entry was pushed
+		if (Info->State != ESaveStructState::Idle || Info->LastSaveTime != Entry.LastSaveTime) continue;
+
+		// Nothing to write, treat it as saved without occupying a task
+		if (IsCleanStruct(Info))
+		{
+			Info->LastRefConut = Info->RefConut;
+			Info->LastSaveTime = NowTime;
+			CleanEntries.Add(FStructDueEntry{ NowTime, Entry.Handle });
+			continue;
+		}
+
+		Partition.DueQueue.Enqueue(Entry);
+		++Partition.DueQueueNum;
+	}
+
+	for (const FStructDueEntry& Entry : CleanEntries)
+	{
+		DueHeap.HeapPush(Entry);
+	}
+}
+
+void UAutoSaveSubsystem::MaintainPartitions(const FDateTime& NowTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_AutoSaveMaintenance);
+
+	// A single partition is not worth waking the workers of the task graph
+	ParallelFor(Partitions.Num(), [this, &NowTime](int32 PartitionIndex) { MaintainPartition(*Partitions[PartitionIndex], NowTime); }, Partitions.Num() < 2);
+}
+
+void UAutoSaveSubsystem::HandleTaskStart()
+{
+	SCOPE_CYCLE_COUNTER(STAT_AutoSaveTaskStart);
+
+	if (!Partitions.Num()) return;
+
+	const FDateTime NowTime = FDateTime::Now();
+
+	MaintainPartitions(NowTime);
+
+	PartitionCursor = (PartitionCursor + 1) % Partitions.Num();
+
+	for (FAutoSaveThrottle* Throttle : { SaveThrottle.Get(), LoadThrottle.Get() })
+	{
+		if (Throttle)
+		{
+			Throttle->Refill(FPlatformTime::Seconds());
+		}
+	}
+
+	if (!TaskPool)
+	{
+		FSaveStructInfo* PreHandleStruct = nullptr;
+
+		// The demand loads of every partition come first
+		for (bool bDemandLoadsOnly : { true, false })
+		{
+			for (int32 Offset = 0; Offset < Partitions.Num() && !PreHandleStruct; ++Offset)
+			{
+				PreHandleStruct = FindPreHandleStruct(*Partitions[(PartitionCursor + Offset) % Partitions.Num()], NowTime, bDemandLoadsOnly, IsSaveThrottled(), IsLoadThrottled());
+			}
+		}
+
+		if (PreHandleStruct && PreHandleStruct->State == ESaveStructState::Idle && ShouldBatchSave(PreHandleStruct))
+		{
+			TArray<FSaveStructInfo*> Infos = { PreHandleStruct };
+
+			CollectSaveBatch(Infos);
+			RunSaveBatch(Infos);
+		}
+		else if (PreHandleStruct) 
+		{
+			{
+				FStructLoadOrSaveTask Task(this, PreHandleStruct);
+				ThrottleTask(Task);
+
+				Task.DoWork();
+
+				RecordTaskLatency(Task, FDateTime::Now());
+				SettleThrottle(Task);
+			}
+
+			ScheduleStruct(PreHandleStruct);
+		}
+
+		return;
+	}
+
+	// Loads are queued up to a second round behind the running tasks, so a worker moves on to the next one without waiting for a tick
+	const int32 MaxInFlightTaskNum = MaxThreadNum * 2;
+
+	// Saves only start on a free thread, they never sit in the pool ahead of a load, and the last threads are left to the loads
+	const int32 MaxSaveInFlightTaskNum = MaxThreadNum - FMath::Min(ReservedLoadThreadNum, MaxThreadNum - 1);
+
+	// The partitions take turns, one task each per round, the demand loads of every partition come first
+	for (bool bDemandLoadsOnly : { true, false })
+	{
+		bool bStarted = true;
+
+		while (bStarted && GetInFlightWorkNum() < MaxInFlightTaskNum)
+		{
+			bStarted = false;
+
+			for (int32 Offset = 0; Offset < Partitions.Num() && GetInFlightWorkNum() < MaxInFlightTaskNum; ++Offset)
+			{
+				FSaveStructPartition& Partition = *Partitions[(PartitionCursor + Offset) % Partitions.Num()];
+
+				if (!Partition.HasInFlightQuota()) continue;
+
+				FSaveStructInfo* PreHandleStruct = FindPreHandleStruct(Partition, NowTime, bDemandLoadsOnly, GetInFlightWorkNum() >= MaxSaveInFlightTaskNum || IsSaveThrottled(), IsLoadThrottled());
+
+				if (!PreHandleStruct) continue;
+
+				StartPreHandleStruct(PreHandleStruct);
+
+				bStarted = true;
+			}
+		}
+	}
+}
+
+void UAutoSaveSubsystem::StartPreHandleStruct(FSaveStructInfo* Info)
+{
+	const bool bSave = Info->State == ESaveStructState::Idle;
+
+	// Members of a group are never snapshotted on their own
+	if (bSave && Info->SaveGroup == NAME_None && ShouldSnapshotIncrementally(Info))
+	{
+		BeginSnapshot(Info);
+	}
+	else if (bSave && ShouldBatchSave(Info))
+	{
+		TArray<FSaveStructInfo*> Infos = { Info };
+
+		CollectSaveBatch(Infos);
+		StartSaveBatch(Infos);
+	}
+	else
+	{
+		StartTask(Info);
+	}
+}
+
+void UAutoSaveSubsystem::HandleTaskDone()
+{
+	SCOPE_CYCLE_COUNTER(STAT_AutoSaveTaskDone);
+
+	const FDateTime NowTime = FDateTime::Now();
+
+	FStructLoadOrSaveTask* Task = nullptr;
+
+	while (CompletedTasks.Dequeue(Task))
+	{
+		FSaveStructInfo* Info = Task->StructInfoPtr;
+
+		if (Task->bBatched)
+		{
+			--BatchedTaskNum;
+
+			if (Task->bLastInBatch)
+			{
+				--InFlightBatchNum;
+			}
+		}
+
+		if (Task->bFlush)
+		{
+			FlushTasks.Remove(Task);
+		}
+		else
+		{
+			RecordTaskLatency(*Task, NowTime);
+			SettleThrottle(*Task);
+		}
+
+		// The task updates the state of the struct when destroyed
+		delete Task;
+		--InFlightTaskNum;
+		--GetPartition(Info).InFlightTaskNum;
+
+		ScheduleStruct(Info);
+	}
+}
+
+void UAutoSaveSubsystem::StartTask(FSaveStructInfo* Info, bool bFlush)
+{
+	FStructLoadOrSaveTask* Task = new FStructLoadOrSaveTask(this, Info);
+	Task->bFlush = bFlush;
+
+	if (bFlush)
+	{
+		FlushTasks.Add(Task);
+	}
+	else
+	{
+		ThrottleTask(*Task);
+	}
+
+	++InFlightTaskNum;
+	++GetPartition(Info).InFlightTaskNum;
+
+	TaskPool->AddQueuedWork(Task);
+}
+
+void UAutoSaveSubsystem::CollectSaveBatch(TArray<FSaveStructInfo*>& InOutInfos)
+{
+	FSaveStructInfo* First = InOutInfos[0];
+
+	// A group is committed as a whole, its members are charged even beyond the budget
+	if (First->SaveGroup != NAME_None)
+	{
+		ChargeThrottle(First);
+
+		for (TMultiMap<FName, FSaveStructInfo*>::TConstKeyIterator It(SaveGroups, First->SaveGroup); It; ++It)
+		{
+			FSaveStructInfo* Member = It.Value();
+
+			// Busy members join a later commit, resident members have been saved when released
+			if (Member == First || Member->State != ESaveStructState::Idle || Member->ResidentNode || IsCleanStruct(Member)) continue;
+
+			ChargeThrottle(Member);
+
+			InOutInfos.Add(Member);
+		}
+
+		return;
+	}
+
+	FSaveStructPartition& Partition = GetPartition(First);
+
+	ChargeThrottle(First);
+
+	// Each struct of the batch counts against the limit of the partition and is charged as it joins, so the batch ends where the budget does
+	while (InOutInfos.Num() < SaveBatchSize && !IsSaveThrottled() && (Partition.MaxInFlightTaskNum <= 0 || Partition.InFlightTaskNum + InOutInfos.Num() < Partition.MaxInFlightTaskNum))
+	{
+		FSaveStructInfo* Info = FindReleasedStruct(Partition, true);
+
+		if (!Info)
+		{
+			Info = FindDueStruct(Partition, true);
+		}
+
+		if (!Info) break;
+
+		ChargeThrottle(Info);
+
+		InOutInfos.Add(Info);
+	}
+}
+
+void UAutoSaveSubsystem::StartSaveBatch(const TArray<FSaveStructInfo*>& Infos, bool bFlush)
+{
+	FStructSaveBatch* Batch = new FStructSaveBatch(this, Infos[0]->SaveGroup);
+
+	for (FSaveStructInfo* Info : Infos)
+	{
+		FStructLoadOrSaveTask* Task = new FStructLoadOrSaveTask(this, Info);
+		Task->bFlush = bFlush;
+		Task->bBatched = true;
+
+		if (bFlush)
+		{
+			FlushTasks.Add(Task);
+		}
+		else
+		{
+			ThrottleTask(*Task, true);
+		}
+
+		Batch->Tasks.Add(Task);
+
+		++GetPartition(Info).InFlightTaskNum;
+	}
+
+	Batch->Tasks.Last()->bLastInBatch = true;
+
+	InFlightTaskNum += Infos.Num();
+	BatchedTaskNum += Infos.Num();
+	++InFlightBatchNum;
+
+	TaskPool->AddQueuedWork(Batch);
+}
+
+void UAutoSaveSubsystem::RunSaveBatch(const TArray<FSaveStructInfo*>& Infos, bool bFlush)
+{
+	FStructSaveBatch Batch(this, Infos[0]->SaveGroup);
+
+	for (FSaveStructInfo* Info : Infos)
+	{
+		FStructLoadOrSaveTask* Task = new FStructLoadOrSaveTask(this, Info);
+
+		if (!bFlush)
+		{
+			ThrottleTask(*Task, true);
+		}
+
+		Batch.Tasks.Add(Task);
+	}
+
+	Batch.Run();
+
+	const FDateTime NowTime = FDateTime::Now();
+
+	for (FStructLoadOrSaveTask* Task : Batch.Tasks)
+	{
+		FSaveStructInfo* Info = Task->StructInfoPtr;
+
+		if (!bFlush)
+		{
+			RecordTaskLatency(*Task, NowTime);
+			SettleThrottle(*Task);
+		}
+
+		delete Task;
+
+		ScheduleStruct(Info);
+	}
+}
+
+void UAutoSaveSubsystem::FStructSaveBatch::Run()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(AutoSaveSaveBatch);
+	SCOPE_CYCLE_COUNTER(STAT_AutoSaveSaveTask);
+
+	ParallelFor(Tasks.Num(), [this](int32 TaskIndex) { Tasks[TaskIndex]->PrepareBatchedSave(); });
+
+	Commit();
+
+	for (FStructLoadOrSaveTask* Task : Tasks)
+	{
+		Task->FinishBatchedSave();
 	}
 }
 
-void UAutoSaveSubsystem::HandleLoadDelegates()
-{
-	// Delegates
+void UAutoSaveSubsystem::FStructSaveBatch::Commit()
+{
+	const TArray<FStructLoadOrSaveTask*> Writes = Tasks.FilterByPredicate([](const FStructLoadOrSaveTask* Task) { return Task->bPendingWrite; });
+
+	if (!Writes.Num()) return;
+
+	TArray<bool> Results;
+	Results.Init(false, Writes.Num());
+
+	uint64 IOCycles = 0;
+
 	{
-		TArray<FString> DelegatesToRemove;
+		FScopedIO IO(Owner->Counters, IOCycles);
 
-		for (const TPair<FString, FSaveStructLoadDelegates>& Delegates : LoadDelegates)
+		if (Owner->Pack)
 		{
-			if (!StructInfos.Contains(Delegates.Key))
+			TArray<FSaveStructPack::FBatchRecord> Records;
+
+			for (FStructLoadOrSaveTask* Task : Writes)
 			{
-				DelegatesToRemove.Add(Delegates.Key);
-				continue;
+				Records.Add(FSaveStructPack::FBatchRecord{ &Task->StructInfoPtr->Filename, &Task->PendingFile, false });
 			}
 
-			if (StructInfos[Delegates.Key]->State == ESaveStructState::Idle || StructInfos[Delegates.Key]->State == ESaveStructState::Saving)
+			Owner->Pack->WriteBatch(Records, Owner->bDurableSaves);
+
+			for (int32 WriteIndex = 0; WriteIndex < Writes.Num(); ++WriteIndex)
 			{
-				Delegates.Value.Broadcast(Delegates.Key);
-				DelegatesToRemove.Add(Delegates.Key);
+				Results[WriteIndex] = Records[WriteIndex].bWritten;
 			}
 		}
+		else if (Group != NAME_None)
+		{
+			const bool bCommitted = CommitGroup(Writes);
 
-		for (const FString& Filename : DelegatesToRemove)
+			for (bool& Result : Results)
+			{
+				Result = bCommitted;
+			}
+		}
+		else
 		{
-			LoadDelegates.Remove(Filename);
+			for (int32 WriteIndex = 0; WriteIndex < Writes.Num(); ++WriteIndex)
+			{
+				Results[WriteIndex] = WriteFile(Writes[WriteIndex]->StructInfoPtr->Filename, Writes[WriteIndex]->PendingFile, Owner->bDurableSaves);
+			}
 		}
 	}
 
-	// DynamicDelegates
+	for (int32 WriteIndex = 0; WriteIndex < Writes.Num(); ++WriteIndex)
+	{
+		RecordBytesWritten(Owner->Counters, Writes[WriteIndex]->BytesWritten, Writes[WriteIndex]->PendingFile.Num());
+
+		Writes[WriteIndex]->FinishWrite(Results[WriteIndex]);
+	}
+}
+
+bool UAutoSaveSubsystem::FStructSaveBatch::CommitGroup(const TArray<FStructLoadOrSaveTask*>& Writes)
+{
+	const FGuid CommitGuid = FGuid::NewGuid();
+	const FString TempSuffix = FString::Printf(TEXT(".%s.tmp"), *CommitGuid.ToString());
+
+	int32 StagedNum = 0;
+
+	FString Manifest = TempSuffix + TEXT("\n");
+
+	for (FStructLoadOrSaveTask* Task : Writes)
 	{
-		TArray<FString> DynamicDelegatesToRemove;
+		if (!WriteFile(Task->StructInfoPtr->Filename + TempSuffix, Task->PendingFile, Owner->bDurableSaves)) break;
+
+		Manifest += Task->StructInfoPtr->Filename + TEXT("\n");
+		++StagedNum;
+	}
+
+	const FString ManifestFilename = GetGroupCommitDir() / FString::Printf(TEXT("%020lld.%s.commit"), FDateTime::UtcNow().GetTicks(), *CommitGuid.ToString());
 
-		for (const TPair<FString, FSaveStructLoadDynamicDelegates>& Delegates : LoadDynamicDelegates)
+	const FTCHARToUTF8 ManifestConverter(*Manifest);
+	const TArray<uint8> ManifestData((const uint8*)ManifestConverter.Get(), ManifestConverter.Length());
+
+	// Once the manifest is written the group counts as committed, a commit interrupted after that is completed at the next start
+	if (StagedNum < Writes.Num() || !WriteFile(ManifestFilename, ManifestData, Owner->bDurableSaves))
+	{
+		for (int32 WriteIndex = 0; WriteIndex < StagedNum; ++WriteIndex)
 		{
-			if (!StructInfos.Contains(Delegates.Key))
-			{
-				DynamicDelegatesToRemove.Add(Delegates.Key);
-				continue;
-			}
+			IFileManager::Get().Delete(*(Writes[WriteIndex]->StructInfoPtr->Filename + TempSuffix), false, false, true);
+		}
 
-			if (StructInfos[Delegates.Key]->State == ESaveStructState::Idle || StructInfos[Delegates.Key]->State == ESaveStructState::Saving)
-			{
-				Delegates.Value.Broadcast(Delegates.Key);
-				DynamicDelegatesToRemove.Add(Delegates.Key);
-			}
+		UE_LOG(LogAutoSave, Error, TEXT("Failed to stage the commit of the Save Struct group '%s'."), *Group.ToString());
+		return false;
+	}
+
+	TArray<FString> Filenames;
+
+	for (FStructLoadOrSaveTask* Task : Writes)
+	{
+		Filenames.Add(Task->StructInfoPtr->Filename);
+	}
+
+	return CompleteGroupCommit(ManifestFilename, TempSuffix, Filenames, Owner->bDurableSaves);
+}
+
+void UAutoSaveSubsystem::FStructSaveBatch::DoThreadedWork()
+{
+	Run();
+
+	for (FStructLoadOrSaveTask* Task : Tasks)
+	{
+		Task->PostCompletion();
+	}
+
+	delete this;
+}
+
+void UAutoSaveSubsystem::FStructSaveBatch::Abandon()
+{
+	for (FStructLoadOrSaveTask* Task : Tasks)
+	{
+		Task->PostCompletion();
+	}
+
+	delete this;
+}
+
+void UAutoSaveSubsystem::BeginSnapshot(FSaveStructInfo* Info)
+{
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+
+	Info->State = ESaveStructState::Snapshotting;
+	Info->LastRefConut = Info->RefConut;
+	Info->LastSaveTime = FDateTime::Now();
+	Info->bDirty = false;
+
+	TArray<uint8> Buffer;
+
+	if (SnapshotBufferPool.Num())
+	{
+		Buffer = SnapshotBufferPool.Pop(false);
+	}
+
+	Snapshots.Add(FPendingSnapshot{ Info, MakeShared<FSaveStructSnapshot>(Info->Struct, Info->Data, MoveTemp(Buffer)) });
+
+	Info->SnapshotWriteSerial = Info->WriteSerial.GetValue();
+
+	++InFlightTaskNum;
+	++GetPartition(Info).InFlightTaskNum;
+
+	// The task that saves the snapshot is counted here, the steps and its completion only add their time
+	Counters.GameThreadTaskCycles += FPlatformTime::Cycles64() - StartCycles;
+	Counters.GameThreadTaskNum++;
+}
+
+void UAutoSaveSubsystem::HandleSnapshots()
+{
+	if (!Snapshots.Num()) return;
+
+	SCOPE_CYCLE_COUNTER(STAT_AutoSaveSnapshots);
+
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+
+	const double EndTime = FPlatformTime::Seconds() + SnapshotFrameBudget.GetTotalSeconds();
+
+	while (Snapshots.Num() && FPlatformTime::Seconds() < EndTime)
+	{
+		if (!StepSnapshot(Snapshots[0], EndTime)) break;
+
+		StartSnapshotTask(0);
+	}
+
+	Counters.GameThreadTaskCycles += FPlatformTime::Cycles64() - StartCycles;
+}
+
+bool UAutoSaveSubsystem::StepSnapshot(FPendingSnapshot& PendingSnapshot, double EndTime)
+{
+	FSaveStructInfo* Info = PendingSnapshot.Info;
+
+	FRWScopeLock ReadLock(Info->DataLock, SLT_ReadOnly);
+
+	// The part copied so far may be older than the rest of the struct
+	if (Info->WriteSerial.GetValue() != Info->SnapshotWriteSerial)
+	{
+		PendingSnapshot.Snapshot->Restart();
+		PendingSnapshot.Snapshot->Finish();
+
+		Info->SnapshotWriteSerial = Info->WriteSerial.GetValue();
+
+		return true;
+	}
+
+	return PendingSnapshot.Snapshot->Step(EndTime);
+}
+
+void UAutoSaveSubsystem::FinishSnapshot(FSaveStructInfo* Info)
+{
+	const int32 SnapshotIndex = Snapshots.IndexOfByPredicate([Info](const FPendingSnapshot& Snapshot) { return Snapshot.Info == Info; });
+
+	check(SnapshotIndex != INDEX_NONE);
+
+	StepSnapshot(Snapshots[SnapshotIndex], MAX_dbl);
+
+	StartSnapshotTask(SnapshotIndex);
+}
+
+void UAutoSaveSubsystem::StartSnapshotTask(int32 SnapshotIndex)
+{
+	FPendingSnapshot PendingSnapshot = MoveTemp(Snapshots[SnapshotIndex]);
+	Snapshots.RemoveAt(SnapshotIndex);
+
+	FStructLoadOrSaveTask* Task = new FStructLoadOrSaveTask(this, PendingSnapshot.Info, PendingSnapshot.Snapshot->Release());
+	ThrottleTask(*Task);
+
+	// Already counted in flight when the snapshot began
+	TaskPool->AddQueuedWork(Task);
+}
+
+void UAutoSaveSubsystem::ReleaseSnapshotBuffer(TArray<uint8>&& Buffer)
+{
+	if (SnapshotBufferPool.Num() >= FMath::Max(MaxThreadNum * 2, 1) || Buffer.Max() > MaxPooledSnapshotSize)
+	{
+		Buffer.Empty();
+		return;
+	}
+
+	Buffer.Reset();
+	SnapshotBufferPool.Add(MoveTemp(Buffer));
+}
+
+void UAutoSaveSubsystem::AbortSnapshots(int32 PartitionIndex)
+{
+	for (int32 SnapshotIndex = Snapshots.Num() - 1; SnapshotIndex >= 0; --SnapshotIndex)
+	{
+		FSaveStructInfo* Info = Snapshots[SnapshotIndex].Info;
+
+		if (PartitionIndex != INDEX_NONE && Info->PartitionIndex != PartitionIndex) continue;
+
+		ReleaseSnapshotBuffer(Snapshots[SnapshotIndex].Snapshot->Abort());
+
+		// The oldest snapshot is advanced first, the order of the others is kept
+		Snapshots.RemoveAt(SnapshotIndex, 1, false);
+
+		Info->State = ESaveStructState::Idle;
+		Info->bDirty = true;
+
+		--InFlightTaskNum;
+		--GetPartition(Info).InFlightTaskNum;
+
+		ScheduleStruct(Info);
+	}
+}
+
+void UAutoSaveSubsystem::MarkStructDirty(FSaveStructInfo* Info)
+{
+	if (bDeinitialized) return;
+
+	if (Info->State == ESaveStructState::Snapshotting)
+	{
+		FinishSnapshot(Info);
+	}
+
+	Info->bDirty = true;
+}
+
+void UAutoSaveSubsystem::WaitForTasks(int32 PartitionIndex)
+{
+	const int32& TaskNum = PartitionIndex == INDEX_NONE ? InFlightTaskNum : Partitions[PartitionIndex]->InFlightTaskNum;
+
+	while (TaskNum > 0)
+	{
+		HandleTaskDone();
+
+		if (TaskNum > 0)
+		{
+			TaskDoneEvent->Wait();
 		}
+	}
+}
 
-		for (const FString& Filename : DynamicDelegatesToRemove)
+void UAutoSaveSubsystem::RecordTaskLatency(const FStructLoadOrSaveTask& Task, const FDateTime& NowTime)
+{
+	Counters.CompletedTaskNum[(int32)Task.Priority]++;
+
+	const FTimespan* Deadline = PriorityDeadlines.Find(Task.Priority);
+
+	if (!Deadline || *Deadline <= FTimespan::Zero()) return;
+
+	const FTimespan Latency = NowTime - Task.RequestTime;
+
+	if (Latency <= *Deadline) return;
+
+	Counters.DeadlineMissNum[(int32)Task.Priority]++;
+
+	UE_LOG(LogAutoSave, Warning, TEXT("Save Struct '%s' missed the %s deadline, %.3f of %.3f seconds."), *Task.StructInfoPtr->Filename,
+		*StaticEnum<ESaveStructPriority>()->GetNameStringByValue((int64)Task.Priority), Latency.GetTotalSeconds(), Deadline->GetTotalSeconds());
+}
+
+FAutoSaveThrottle* UAutoSaveSubsystem::GetThrottle(ESaveStructPriority Priority) const
+{
+	switch (Priority)
+	{
+	case ESaveStructPriority::ReleaseSave:
+	case ESaveStructPriority::BackgroundSave:
+		return SaveThrottle.Get();
+
+	case ESaveStructPriority::NormalLoad:
+	case ESaveStructPriority::PrefetchLoad:
+		return LoadThrottle.Get();
+
+	default: return nullptr;
+	}
+}
+
+bool UAutoSaveSubsystem::IsSaveThrottled() const
+{
+	return SaveThrottle && !SaveThrottle->CanStart();
+}
+
+bool UAutoSaveSubsystem::IsLoadThrottled() const
+{
+	return LoadThrottle && !LoadThrottle->CanStart();
+}
+
+void UAutoSaveSubsystem::ChargeThrottle(const FSaveStructInfo* Info)
+{
+	FAutoSaveThrottle* Throttle = GetThrottle(Info->Priority);
+
+	if (!Throttle) return;
+
+	// The size of the last image stands in until the task is done
+	Throttle->Charge(Info->ImageSize, 1);
+}
+
+void UAutoSaveSubsystem::ThrottleTask(FStructLoadOrSaveTask& Task, bool bCharged)
+{
+	if (!GetThrottle(Task.Priority)) return;
+
+	Task.ChargedSize = Task.StructInfoPtr->ImageSize;
+
+	if (!bCharged)
+	{
+		ChargeThrottle(Task.StructInfoPtr);
+	}
+}
+
+void UAutoSaveSubsystem::SettleThrottle(const FStructLoadOrSaveTask& Task)
+{
+	if (Task.ChargedSize == INDEX_NONE) return;
+
+	FAutoSaveThrottle* Throttle = GetThrottle(Task.Priority);
+
+	if (!Throttle) return;
+
+	Throttle->Charge(Task.BytesRead + Task.BytesWritten - Task.ChargedSize, 0);
+}
+
+int32 UAutoSaveSubsystem::GetSaveBacklogNum() const
+{
+	int32 BacklogNum = 0;
+
+	for (const TUniquePtr<FSaveStructPartition>& Partition : Partitions)
+	{
+		BacklogNum += Partition->DueQueueNum + Partition->ReleaseEntryNum;
+	}
+
+	return BacklogNum;
+}
+
+void UAutoSaveSubsystem::UpdateBackpressure()
+{
+	if (SaveBacklogThreshold <= 0) return;
+
+	const int32 BacklogNum = GetSaveBacklogNum();
+
+	// Lifted at half the threshold, so the signal does not flap around it
+	const bool bBackpressure = bSaveBackpressure ? BacklogNum > SaveBacklogThreshold / 2 : BacklogNum > SaveBacklogThreshold;
+
+	if (bBackpressure == bSaveBackpressure) return;
+
+	bSaveBackpressure = bBackpressure;
+
+	if (bBackpressure)
+	{
+		Counters.BackpressureNum++;
+
+		UE_LOG(LogAutoSave, Warning, TEXT("The save backlog of %d Save Structs exceeds the threshold of %d."), BacklogNum, SaveBacklogThreshold);
+	}
+	else
+	{
+		UE_LOG(LogAutoSave, Log, TEXT("The save backlog is down to %d Save Structs."), BacklogNum);
+	}
+
+	OnSaveBackpressure.Broadcast(bBackpressure);
+	OnSaveBackpressureDynamic.Broadcast(bBackpressure);
+}
+
+void UAutoSaveSubsystem::HandleLoadDelegates()
+{
+	if (!LoadDelegateStructs.Num()) return;
+
+	SCOPE_CYCLE_COUNTER(STAT_AutoSaveLoadDelegates);
+
+	// The callbacks may bind new delegates, they are handled by the next tick
+	TArray<FSaveStructHandle> Handles = MoveTemp(LoadDelegateStructs);
+
+	for (const FSaveStructHandle& Handle : Handles)
+	{
+		FSaveStructInfo* Info = FindStruct(Handle);
+
+		// The struct was removed together with its delegates
+		if (!Info) continue;
+
+		// Failed structs are reported as well, the callback tells them apart with IsSaveStructLoaded
+		if (!Info->IsLoaded() && Info->State != ESaveStructState::Failed)
 		{
-			LoadDynamicDelegates.Remove(Filename);
+			LoadDelegateStructs.Add(Handle);
+			continue;
 		}
+
+		const FString Filename = Info->Filename;
+
+		FSaveStructLoadDelegates Delegates = MoveTemp(Info->LoadDelegates);
+		FSaveStructLoadDynamicDelegates DynamicDelegates = MoveTemp(Info->LoadDynamicDelegates);
+
+		Info->LoadDelegates.Clear();
+		Info->LoadDynamicDelegates.Clear();
+
+		Delegates.Broadcast(Filename);
+		DynamicDelegates.Broadcast(Filename);
 	}
 }
 
 void UAutoSaveSubsystem::Initialize(FSubsystemCollectionBase & Collection)
 {
+	InfoPool = MakeShared<FSaveStructInfoPool>();
+	PayloadAllocator = MakeShared<FSaveStructPayloadAllocator>(PayloadCacheBudget);
+
+	Partitions.Add(MakeUnique<FSaveStructPartition>());
+
+	// Without a budget nothing is throttled
+	if (SaveBytesPerSecond > 0 || SaveOperationsPerSecond > 0)
+	{
+		SaveThrottle = MakeShared<FAutoSaveThrottle>(SaveBytesPerSecond, SaveOperationsPerSecond);
+	}
+
+	if (LoadBytesPerSecond > 0 || LoadOperationsPerSecond > 0)
+	{
+		LoadThrottle = MakeShared<FAutoSaveThrottle>(LoadBytesPerSecond, LoadOperationsPerSecond);
+	}
+
 	if (MaxThreadNum > 0)
-		TaskThreads.SetNum(MaxThreadNum);
-}
+	{
+		TaskDoneEvent = FPlatformProcess::GetSynchEventFromPool(false);
 
-void UAutoSaveSubsystem::Deinitialize()
-{
-	// Make sure the tasks are completed
-	for (TUniquePtr<FAsyncTask<FStructLoadOrSaveTask>>& Task : TaskThreads)
+		TaskPool.Reset(FQueuedThreadPool::Allocate());
+
+		// Serializing deep structs needs more stack than the default of the pool
+		if (!TaskPool->Create(MaxThreadNum, 128 * 1024, TPri_BelowNormal, TEXT("AutoSaveThreadPool")))
+		{
+			UE_LOG(LogAutoSave, Error, TEXT("Failed to create the thread pool, fall back to running the tasks on the game thread."));
+			TaskPool.Reset();
+		}
+	}
+
+	if (bPackedStorage)
 	{
-		if (!Task) continue;
-		Task->EnsureCompletion();
-		Task = nullptr;
+		Pack = MakeShared<FSaveStructPack>(FPaths::Combine(FPaths::ProjectSavedDir(), PackFilename), PackDefragmentRatio);
+
+		if (!Pack->Open())
+		{
+			UE_LOG(LogAutoSave, Error, TEXT("Failed to open the pack '%s', fall back to a file per Save Struct."), *PackFilename);
+			Pack.Reset();
+		}
 	}
 
-	// Make sure objects are saved
-	for (const TPair<FString, TUniquePtr<FSaveStructInfo>>& Info : StructInfos)
+	// Group commits only exist with a file per struct
+	if (!Pack)
 	{
-		// Skip objects that are not loaded
-		if (Info.Value->State == ESaveStructState::Preload) continue;
+		RecoverGroupCommits();
+	}
 
-		check(Info.Value->State == ESaveStructState::Idle);
+	SnapshotBufferPool.Reserve(FMath::Max(MaxThreadNum * 2, 1));
+}
 
+void UAutoSaveSubsystem::Deinitialize()
+{
+	for (const TPair<FString, FSaveStructInfo*>& Info : StructInfos)
+	{
 		if (Info.Value->RefConut > 0)
 		{
 			UE_LOG(LogAutoSave, Warning, TEXT("The subsystem deinitialize, but '%s' still has references."), *Info.Value->Filename);
 		}
+	}
+
+	FlushSaveStructs(ShutdownFlushDeadline);
+
+	if (TaskPool)
+	{
+		TaskPool->Destroy();
+		TaskPool.Reset();
+
+		// Nothing should be left, but abandoned tasks are posted as well
+		HandleTaskDone();
+	}
+
+	if (TaskDoneEvent)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(TaskDoneEvent);
+		TaskDoneEvent = nullptr;
+	}
+
+	Partitions.Empty();
+	PartitionRoots.Empty();
+	PartitionCursor = 0;
+
+	SaveThrottle.Reset();
+	LoadThrottle.Reset();
+	bSaveBackpressure = false;
+
+	for (FSaveStructInfo* Info : ResidentList)
+	{
+		Info->ResidentNode = nullptr;
+	}
+
+	ResidentList.Empty();
+	ResidentSize = 0;
+
+	SaveGroups.Empty();
 
-		FAsyncTask<FStructLoadOrSaveTask> Task(Info.Value.Get());
-		Task.StartSynchronousTask();
+	LoadDelegateStructs.Empty();
+
+	// The structs still referenced are destroyed as well, FSaveStructPtr finds its handle stale from here on
+	bDeinitialized = true;
+
+	for (const TPair<FString, FSaveStructInfo*>& Info : StructInfos)
+	{
+		DestroyStructInfo(Info.Value);
 	}
+
+	StructInfos.Empty();
+	Slots.Empty();
+	FreeSlots.Empty();
+	ScriptStructHooker.Empty();
+
+	InfoPool.Reset();
+	PayloadAllocator.Reset();
+
+	SerializationPlans.Empty();
+
+	Pack.Reset();
 }
 
 void UAutoSaveSubsystem::Tick(float DeltaTime)
 {
 	HandleTaskDone();
 	HandleTaskStart();
+	HandleSnapshots();
 	HandleLoadDelegates();
+
+	UpdateBackpressure();
+
+	SET_DWORD_STAT(STAT_AutoSaveStructNum, StructInfos.Num());
+	SET_DWORD_STAT(STAT_AutoSaveQueuedTaskNum, GetQueuedTaskNum());
+	SET_DWORD_STAT(STAT_AutoSaveInFlightTaskNum, InFlightTaskNum);
+	SET_DWORD_STAT(STAT_AutoSaveSaveBacklogNum, GetSaveBacklogNum());
+	SET_MEMORY_STAT(STAT_AutoSaveResidentSize, ResidentSize);
+	SET_MEMORY_STAT(STAT_AutoSavePayloadSize, GetPayloadStats().LiveSize);
+	SET_MEMORY_STAT(STAT_AutoSavePayloadCacheSize, GetPayloadStats().CachedSize);
+}
+
+TStatId UAutoSaveSubsystem::GetStatId() const
+{
+	return GET_STATID(STAT_AutoSaveTick);
 }
@@ -0,0 +1,36 @@
+#include "AutoSaveThrottle.h"
+
+FAutoSaveThrottle::FAutoSaveThrottle(int64 BytesPerSecond, int32 OperationsPerSecond)
+	: LastRefillSeconds(FPlatformTime::Seconds())
+{
+	ByteBucket.Rate = FMath::Max<double>(BytesPerSecond, 0.0);
+	ByteBucket.Tokens = ByteBucket.Rate * BurstSeconds;
+
+	OperationBucket.Rate = FMath::Max<double>(OperationsPerSecond, 0.0);
+	OperationBucket.Tokens = OperationBucket.Rate * BurstSeconds;
+}
+
+void FAutoSaveThrottle::Refill(double NowSeconds)
+{
+	const double ElapsedSeconds = FMath::Max(NowSeconds - LastRefillSeconds, 0.0);
+
+	LastRefillSeconds = NowSeconds;
+
+	for (FTokenBucket* Bucket : { &ByteBucket, &OperationBucket })
+	{
+		Bucket->Charge(-Bucket->Rate * ElapsedSeconds);
+	}
+}
+
+void FAutoSaveThrottle::Charge(int64 Bytes, int32 Operations)
+{
+	ByteBucket.Charge(Bytes);
+	OperationBucket.Charge(Operations);
+}
+
+void FAutoSaveThrottle::FTokenBucket::Charge(double Amount)
+{
+	if (Rate <= 0.0) return;
+
+	Tokens = FMath::Min(Tokens - Amount, Rate * BurstSeconds);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Token buckets for the bytes and the files of one kind of task, refilled at their rates up to a second worth of tokens.
+// A task is charged its estimated size when it starts and the difference to the actual size once it is done.
+// A bucket in debt starts nothing until it is refilled, so a large task delays the following ones instead of being split.
+// Only used by the game thread.
+class FAutoSaveThrottle : public FNoncopyable
+{
+public:
+
+	// Zero for no limit
+	FAutoSaveThrottle(int64 BytesPerSecond, int32 OperationsPerSecond);
+
+	// Add the tokens earned since the last refill
+	void Refill(double NowSeconds);
+
+	FORCEINLINE bool CanStart() const { return ByteBucket.HasTokens() && OperationBucket.HasTokens(); }
+
+	// Negative amounts give back what an estimate charged too much
+	void Charge(int64 Bytes, int32 Operations);
+
+private:
+
+	struct FTokenBucket
+	{
+		double Rate = 0.0;
+
+		double Tokens = 0.0;
+
+		FORCEINLINE bool HasTokens() const { return Rate <= 0.0 || Tokens > 0.0; }
+
+		void Charge(double Amount);
+	};
+
+	static constexpr double BurstSeconds = 1.0;
+
+	FTokenBucket ByteBucket;
+
+	FTokenBucket OperationBucket;
+
+	double LastRefillSeconds;
+
+};
@@ -1,8 +1,9 @@
 #include "Blueprint/AutoSaveBlueprintLibrary.h"
 
 #include "Kismet/GameplayStatics.h"
+#include "Misc/ScopeRWLock.h"
 
-bool UAutoSaveBlueprintLibrary::AddSaveStructRef(UObject * WorldContextObject, const FString & Filename, UScriptStruct * ScriptStruct, FSaveStructLoadDynamicDelegate LoadCallback)
+bool UAutoSaveBlueprintLibrary::AddSaveStructRef(UObject * WorldContextObject, const FString & Filename, UScriptStruct * ScriptStruct, FSaveStructLoadDynamicDelegate LoadCallback, ESaveStructPriority Priority)
 {
 	UGameInstance* GameInstance = UGameplayStatics::GetGameInstance(WorldContextObject);
 
@@ -12,7 +13,7 @@ bool UAutoSaveBlueprintLibrary::AddSaveStructRef(UObject * WorldContextObject, c
 	
 	if (!AutoSaveSubsystem) return false;
 
-	return AutoSaveSubsystem->AddSaveStructRef(Filename, ScriptStruct, LoadCallback) != nullptr;
+	return AutoSaveSubsystem->AddSaveStructRef(Filename, ScriptStruct, LoadCallback, Priority) != nullptr;
 }
 
 void UAutoSaveBlueprintLibrary::RemoveSaveStructRef(UObject * WorldContextObject, const FString & Filename)
@@ -28,48 +29,155 @@ void UAutoSaveBlueprintLibrary::RemoveSaveStructRef(UObject * WorldContextObject
 	AutoSaveSubsystem->RemoveSaveStructRef(Filename);
 }
 
-bool UAutoSaveBlueprintLibrary::Generic_TryGetSaveStruct(UObject * WorldContextObject, const FString & Filename, UScriptStruct * ScriptStruct, void * Value)
+int32 UAutoSaveBlueprintLibrary::PrefetchSaveStructs(UObject * WorldContextObject, const TArray<FSaveStructPrefetchRequest>& Requests, int32 Priority)
 {
 	UGameInstance* GameInstance = UGameplayStatics::GetGameInstance(WorldContextObject);
 
-	if (!GameInstance) return false;
+	if (!GameInstance) return 0;
+
+	UAutoSaveSubsystem* AutoSaveSubsystem = GameInstance->GetSubsystem<UAutoSaveSubsystem>();
+
+	if (!AutoSaveSubsystem) return 0;
+
+	return AutoSaveSubsystem->PrefetchSaveStructs(Requests, Priority);
+}
+
+void UAutoSaveBlueprintLibrary::MarkSaveStructDirty(UObject * WorldContextObject, const FString & Filename)
+{
+	UGameInstance* GameInstance = UGameplayStatics::GetGameInstance(WorldContextObject);
+
+	if (!GameInstance) return;
 
 	UAutoSaveSubsystem* AutoSaveSubsystem = GameInstance->GetSubsystem<UAutoSaveSubsystem>();
 
+	if (!AutoSaveSubsystem) return;
+
+	AutoSaveSubsystem->MarkSaveStructDirty(Filename);
+}
+
+FSaveStructHandle UAutoSaveBlueprintLibrary::AcquireSaveStruct(UObject * WorldContextObject, const FString & Filename, UScriptStruct * ScriptStruct, FSaveStructLoadDynamicDelegate LoadCallback, bool & bSuccess, ESaveStructPriority Priority)
+{
+	bSuccess = false;
+
+	UAutoSaveSubsystem* AutoSaveSubsystem = GetAutoSaveSubsystem(WorldContextObject);
+
+	if (!AutoSaveSubsystem) return FSaveStructHandle();
+
+	FSaveStructInfo* Info = AutoSaveSubsystem->AddStructRef(Filename, ScriptStruct, Priority);
+
+	if (!Info) return FSaveStructHandle();
+
+	AutoSaveSubsystem->AddLoadDelegate(Info, LoadCallback);
+
+	bSuccess = true;
+
+	return Info->Handle;
+}
+
+void UAutoSaveBlueprintLibrary::ReleaseSaveStruct(UObject * WorldContextObject, FSaveStructHandle Handle)
+{
+	UAutoSaveSubsystem* AutoSaveSubsystem = GetAutoSaveSubsystem(WorldContextObject);
+
+	if (!AutoSaveSubsystem) return;
+
+	AutoSaveSubsystem->RemoveSaveStructRef(Handle);
+}
+
+bool UAutoSaveBlueprintLibrary::IsSaveStructHandleLoaded(UObject * WorldContextObject, FSaveStructHandle Handle)
+{
+	UAutoSaveSubsystem* AutoSaveSubsystem = GetAutoSaveSubsystem(WorldContextObject);
+
 	if (!AutoSaveSubsystem) return false;
 
-	if (!AutoSaveSubsystem->StructInfos.Contains(Filename)) return false;
+	return AutoSaveSubsystem->IsSaveStructLoaded(Handle);
+}
 
-	FSaveStructInfo* Info = AutoSaveSubsystem->StructInfos[Filename].Get();
+void UAutoSaveBlueprintLibrary::MarkSaveStructDirtyByHandle(UObject * WorldContextObject, FSaveStructHandle Handle)
+{
+	UAutoSaveSubsystem* AutoSaveSubsystem = GetAutoSaveSubsystem(WorldContextObject);
 
-	if (Info->State == ESaveStructState::Preload || Info->State == ESaveStructState::Loading) return false;
+	if (!AutoSaveSubsystem) return;
 
-	if (Info->Struct != ScriptStruct) return false;
+	AutoSaveSubsystem->MarkSaveStructDirty(Handle);
+}
 
-	ScriptStruct->CopyScriptStruct(Value, Info->Data.GetData());
+bool UAutoSaveBlueprintLibrary::Generic_TryGetSaveStruct(UObject * WorldContextObject, const FString & Filename, UScriptStruct * ScriptStruct, void * Value)
+{
+	UAutoSaveSubsystem* AutoSaveSubsystem = GetAutoSaveSubsystem(WorldContextObject);
 
-	return true;
+	if (!AutoSaveSubsystem) return false;
+
+	FSaveStructInfo* const* Info = AutoSaveSubsystem->StructInfos.Find(Filename);
+
+	return Info && CopyFromSaveStruct(*Info, ScriptStruct, Value);
 }
 
 bool UAutoSaveBlueprintLibrary::Generic_TrySetSaveStruct(UObject * WorldContextObject, const FString & Filename, UScriptStruct * ScriptStruct, void * Value)
 {
-	UGameInstance* GameInstance = UGameplayStatics::GetGameInstance(WorldContextObject);
+	UAutoSaveSubsystem* AutoSaveSubsystem = GetAutoSaveSubsystem(WorldContextObject);
 
-	if (!GameInstance) return false;
+	if (!AutoSaveSubsystem) return false;
 
-	UAutoSaveSubsystem* AutoSaveSubsystem = GameInstance->GetSubsystem<UAutoSaveSubsystem>();
+	FSaveStructInfo* const* Info = AutoSaveSubsystem->StructInfos.Find(Filename);
+
+	return Info && CopyToSaveStruct(AutoSaveSubsystem, *Info, ScriptStruct, Value);
+}
+
+bool UAutoSaveBlueprintLibrary::Generic_TryGetSaveStructByHandle(UObject * WorldContextObject, FSaveStructHandle Handle, UScriptStruct * ScriptStruct, void * Value)
+{
+	UAutoSaveSubsystem* AutoSaveSubsystem = GetAutoSaveSubsystem(WorldContextObject);
 
 	if (!AutoSaveSubsystem) return false;
 
-	if (!AutoSaveSubsystem->StructInfos.Contains(Filename)) return false;
+	FSaveStructInfo* Info = AutoSaveSubsystem->FindStruct(Handle);
+
+	return Info && CopyFromSaveStruct(Info, ScriptStruct, Value);
+}
+
+bool UAutoSaveBlueprintLibrary::Generic_TrySetSaveStructByHandle(UObject * WorldContextObject, FSaveStructHandle Handle, UScriptStruct * ScriptStruct, void * Value)
+{
+	UAutoSaveSubsystem* AutoSaveSubsystem = GetAutoSaveSubsystem(WorldContextObject);
 
-	FSaveStructInfo* Info = AutoSaveSubsystem->StructInfos[Filename].Get();
+	if (!AutoSaveSubsystem) return false;
 
-	if (Info->State == ESaveStructState::Preload || Info->State == ESaveStructState::Loading) return false;
+	FSaveStructInfo* Info = AutoSaveSubsystem->FindStruct(Handle);
+
+	return Info && CopyToSaveStruct(AutoSaveSubsystem, Info, ScriptStruct, Value);
+}
+
+UAutoSaveSubsystem* UAutoSaveBlueprintLibrary::GetAutoSaveSubsystem(UObject * WorldContextObject)
+{
+	UGameInstance* GameInstance = UGameplayStatics::GetGameInstance(WorldContextObject);
+
+	if (!GameInstance) return nullptr;
+
+	return GameInstance->GetSubsystem<UAutoSaveSubsystem>();
+}
+
+bool UAutoSaveBlueprintLibrary::CopyFromSaveStruct(FSaveStructInfo * Info, UScriptStruct * ScriptStruct, void * Value)
+{
+	if (!Info->IsLoaded()) return false;
 
 	if (Info->Struct != ScriptStruct) return false;
 
-	ScriptStruct->CopyScriptStruct(Info->Data.GetData(), Value);
+	FRWScopeLock ReadLock(Info->DataLock, SLT_ReadOnly);
+
+	ScriptStruct->CopyScriptStruct(Value, Info->Data);
+
+	return true;
+}
+
+bool UAutoSaveBlueprintLibrary::CopyToSaveStruct(UAutoSaveSubsystem * AutoSaveSubsystem, FSaveStructInfo * Info, UScriptStruct * ScriptStruct, void * Value)
+{
+	if (!Info->IsLoaded()) return false;
+
+	if (Info->Struct != ScriptStruct) return false;
+
+	AutoSaveSubsystem->MarkStructDirty(Info);
+
+	FRWScopeLock WriteLock(Info->DataLock, SLT_Write);
+
+	ScriptStruct->CopyScriptStruct(Info->Data, Value);
 
 	return true;
 }
@@ -0,0 +1,133 @@
+#include "SaveStructAllocator.h"
+
+FSaveStructInfoPool::~FSaveStructInfoPool()
+{
+	check(Num == 0);
+
+	for (void* Slab : Slabs)
+	{
+		FMemory::Free(Slab);
+	}
+}
+
+FSaveStructInfo* FSaveStructInfoPool::Allocate()
+{
+	if (!FreeInfos.Num())
+	{
+		FSaveStructInfo* Slab = (FSaveStructInfo*)FMemory::Malloc(sizeof(FSaveStructInfo) * SlabInfoNum, alignof(FSaveStructInfo));
+
+		Slabs.Add(Slab);
+
+		// Handed out from the front of the slab
+		for (int32 InfoIndex = SlabInfoNum - 1; InfoIndex >= 0; --InfoIndex)
+		{
+			FreeInfos.Add(Slab + InfoIndex);
+		}
+	}
+
+	++Num;
+
+	return new (FreeInfos.Pop(false)) FSaveStructInfo();
+}
+
+void FSaveStructInfoPool::Free(FSaveStructInfo* Info)
+{
+	Info->~FSaveStructInfo();
+
+	FreeInfos.Add(Info);
+
+	--Num;
+}
+
+FSaveStructPayloadAllocator::FSaveStructPayloadAllocator(int64 InCacheBudget)
+	: CacheBudget(InCacheBudget)
+{
+}
+
+FSaveStructPayloadAllocator::~FSaveStructPayloadAllocator()
+{
+	check(Stats.LiveBlockNum == 0);
+
+	Trim();
+}
+
+int32 FSaveStructPayloadAllocator::GetClassIndex(int32 Size, int32 Alignment)
+{
+	if (Alignment > ClassAlignment) return INDEX_NONE;
+
+	const int32 ClassIndex = FMath::Max((int32)FMath::CeilLogTwo((uint32)Size), MinClassShift) - MinClassShift;
+
+	return ClassIndex < ClassNum ? ClassIndex : INDEX_NONE;
+}
+
+uint8* FSaveStructPayloadAllocator::Allocate(int32 Size, int32 Alignment)
+{
+	const int32 ClassIndex = GetClassIndex(Size, Alignment);
+
+	uint8* Block = nullptr;
+
+	if (ClassIndex == INDEX_NONE)
+	{
+		Block = (uint8*)FMemory::Malloc(Size, Alignment);
+		Stats.LiveSize += Size;
+	}
+	else if (FreeBlocks[ClassIndex].Num())
+	{
+		Block = FreeBlocks[ClassIndex].Pop(false);
+		Stats.CachedSize -= GetClassSize(ClassIndex);
+		Stats.LiveSize += GetClassSize(ClassIndex);
+		Stats.ReusedNum++;
+	}
+	else
+	{
+		Block = (uint8*)FMemory::Malloc(GetClassSize(ClassIndex), ClassAlignment);
+		Stats.LiveSize += GetClassSize(ClassIndex);
+	}
+
+	Stats.AllocationNum++;
+	Stats.LiveBlockNum++;
+
+	check(IsAligned(Block, Alignment));
+
+	return Block;
+}
+
+void FSaveStructPayloadAllocator::Free(uint8* Block, int32 Size, int32 Alignment)
+{
+	const int32 ClassIndex = GetClassIndex(Size, Alignment);
+
+	Stats.LiveBlockNum--;
+
+	if (ClassIndex == INDEX_NONE)
+	{
+		Stats.LiveSize -= Size;
+		FMemory::Free(Block);
+		return;
+	}
+
+	Stats.LiveSize -= GetClassSize(ClassIndex);
+
+	if (Stats.CachedSize + GetClassSize(ClassIndex) > CacheBudget)
+	{
+		FMemory::Free(Block);
+		return;
+	}
+
+	FreeBlocks[ClassIndex].Add(Block);
+	Stats.CachedSize += GetClassSize(ClassIndex);
+}
+
+void FSaveStructPayloadAllocator::Trim()
+{
+	for (TArray<uint8*>& Blocks : FreeBlocks)
+	{
+		for (uint8* Block : Blocks)
+		{
+			FMemory::Free(Block);
+		}
+
+		Blocks.Empty();
+	}
+
+	Stats.CachedSize = 0;
+}
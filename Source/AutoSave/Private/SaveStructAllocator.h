@@ -0,0 +1,75 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AutoSaveSubsystem.h"
+
+// Struct infos carved out of slabs, so they sit next to each other instead of scattered across the heap.
+// Freed infos are reused before a new slab is allocated, the slabs are only returned when the pool is destroyed.
+class FSaveStructInfoPool : public FNoncopyable
+{
+public:
+
+	~FSaveStructInfoPool();
+
+	// Value initialized like new FSaveStructInfo()
+	FSaveStructInfo* Allocate();
+
+	void Free(FSaveStructInfo* Info);
+
+	FORCEINLINE int32 GetNum() const { return Num; }
+
+	FORCEINLINE int32 GetCapacity() const { return Slabs.Num() * SlabInfoNum; }
+
+private:
+
+	static constexpr int32 SlabInfoNum = 64;
+
+	TArray<void*> Slabs;
+
+	TArray<FSaveStructInfo*> FreeInfos;
+
+	int32 Num = 0;
+
+};
+
+// Struct payloads in power of two size classes, aligned to at least the alignment of the struct.
+// Freed blocks are cached by their class up to a budget, larger or stricter aligned payloads go to the heap directly.
+// Only used by the game thread.
+class FSaveStructPayloadAllocator : public FNoncopyable
+{
+public:
+
+	FSaveStructPayloadAllocator(int64 InCacheBudget);
+
+	~FSaveStructPayloadAllocator();
+
+	uint8* Allocate(int32 Size, int32 Alignment);
+
+	// Size and alignment have to be the ones the block was allocated with
+	void Free(uint8* Block, int32 Size, int32 Alignment);
+
+	// Return the cached blocks to the heap
+	void Trim();
+
+	FORCEINLINE const FAutoSavePayloadStats& GetStats() const { return Stats; }
+
+private:
+
+	static constexpr int32 MinClassShift = 4;
+
+	static constexpr int32 ClassNum = 13;
+
+	static constexpr int32 ClassAlignment = 16;
+
+	// INDEX_NONE for the payloads that bypass the classes
+	static int32 GetClassIndex(int32 Size, int32 Alignment);
+
+	FORCEINLINE static int32 GetClassSize(int32 ClassIndex) { return 1 << (ClassIndex + MinClassShift); }
+
+	const int64 CacheBudget;
+
+	TArray<uint8*> FreeBlocks[ClassNum];
+
+	FAutoSavePayloadStats Stats;
+
+};
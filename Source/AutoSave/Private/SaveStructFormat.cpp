@@ -0,0 +1,401 @@
+#include "SaveStructFormat.h"
+
+#include "AutoSaveLog.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/Compression.h"
+#include "Serialization/LargeMemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace
+{
+	const uint32 FormatMagic = 0x5A435341; // 'ASCZ'
+
+	// Version 2 adds the chunked images
+	const uint8 FormatVersion = 2;
+
+	// The image follows as chunk records instead of a single compressed block
+	const uint16 FormatFlagChunked = 1;
+
+	struct FFormatHeader
+	{
+		uint32 Magic = FormatMagic;
+		uint8 Version = FormatVersion;
+		uint8 Compression = (uint8)ESaveStructCompression::None;
+		uint16 Flags = 0;
+		int64 ImageSize = 0;
+
+		friend FArchive& operator<<(FArchive& Ar, FFormatHeader& Header)
+		{
+			return Ar << Header.Magic << Header.Version << Header.Compression << Header.Flags << Header.ImageSize;
+		}
+	};
+
+	const int32 FormatHeaderSize = 16;
+
+	// RawSize, StoredSize, a chunk is stored raw when both are the same
+	const int32 ChunkHeaderSize = 8;
+
+	bool DecodeChunks(FName FormatName, const uint8* Data, int64 DataSize, TArray<uint8>& InOutBuffer)
+	{
+		int64 Offset = FormatHeaderSize;
+		int64 ImageOffset = 0;
+
+		while (ImageOffset < InOutBuffer.Num())
+		{
+			if (Offset + ChunkHeaderSize > DataSize) return false;
+
+			int32 RawSize = 0;
+			int32 StoredSize = 0;
+
+			{
+				FLargeMemoryReader Reader(Data + Offset, ChunkHeaderSize);
+				Reader << RawSize << StoredSize;
+			}
+
+			Offset += ChunkHeaderSize;
+
+			if (RawSize <= 0 || StoredSize <= 0 || ImageOffset + RawSize > InOutBuffer.Num() || Offset + StoredSize > DataSize) return false;
+
+			if (StoredSize == RawSize)
+			{
+				FMemory::Memcpy(InOutBuffer.GetData() + ImageOffset, Data + Offset, RawSize);
+			}
+			else if (!FCompression::UncompressMemory(FormatName, InOutBuffer.GetData() + ImageOffset, RawSize, Data + Offset, StoredSize))
+			{
+				return false;
+			}
+
+			Offset += StoredSize;
+			ImageOffset += RawSize;
+		}
+
+		return true;
+	}
+}
+
+bool FSaveStructFormat::IsCompressionAvailable(ESaveStructCompression Compression)
+{
+	const FName FormatName = GetFormatName(Compression);
+
+	return !FormatName.IsNone() && FCompression::IsFormatValid(FormatName);
+}
+
+FName FSaveStructFormat::GetFormatName(ESaveStructCompression Compression)
+{
+	switch (Compression)
+	{
+	case ESaveStructCompression::Zlib:  return NAME_Zlib;
+	case ESaveStructCompression::Gzip:  return NAME_Gzip;
+	case ESaveStructCompression::LZ4:   return NAME_LZ4;
+	case ESaveStructCompression::Oodle: return TEXT("Oodle");
+	default: return NAME_None;
+	}
+}
+
+void FSaveStructFormat::Encode(const TArray<uint8>& Image, ESaveStructCompression Compression, TArray<uint8>& OutData)
+{
+	if (!IsCompressionAvailable(Compression))
+	{
+		OutData = Image;
+		return;
+	}
+
+	const FName FormatName = GetFormatName(Compression);
+
+	int32 CompressedSize = FCompression::CompressMemoryBound(FormatName, Image.Num());
+
+	OutData.SetNumUninitialized(FormatHeaderSize + CompressedSize, false);
+
+	const bool bCompressed = FCompression::CompressMemory(FormatName, OutData.GetData() + FormatHeaderSize, CompressedSize, Image.GetData(), Image.Num());
+
+	// Incompressible images are cheaper to store raw
+	if (!bCompressed || FormatHeaderSize + CompressedSize >= Image.Num())
+	{
+		OutData = Image;
+		return;
+	}
+
+	OutData.SetNum(FormatHeaderSize + CompressedSize, false);
+
+	FFormatHeader Header;
+	Header.Compression = (uint8)Compression;
+	Header.ImageSize = Image.Num();
+
+	TArray<uint8> HeaderBuffer;
+	FMemoryWriter Writer(HeaderBuffer);
+	Writer << Header;
+
+	check(HeaderBuffer.Num() == FormatHeaderSize);
+
+	FMemory::Memcpy(OutData.GetData(), HeaderBuffer.GetData(), FormatHeaderSize);
+}
+
+bool FSaveStructFormat::Decode(TArray<uint8>& InOutData)
+{
+	TArray<uint8> Buffer;
+	const uint8* Image = nullptr;
+	int64 ImageSize = 0;
+
+	if (!Decode(InOutData.GetData(), InOutData.Num(), Buffer, Image, ImageSize)) return false;
+
+	if (Image != InOutData.GetData())
+	{
+		InOutData = MoveTemp(Buffer);
+	}
+
+	return true;
+}
+
+bool FSaveStructFormat::Decode(const uint8* Data, int64 DataSize, TArray<uint8>& OutBuffer, const uint8*& OutImage, int64& OutImageSize)
+{
+	OutImage = Data;
+	OutImageSize = DataSize;
+
+	if (DataSize < FormatHeaderSize) return true;
+
+	FFormatHeader Header;
+
+	{
+		FLargeMemoryReader Reader(Data, FormatHeaderSize);
+		Reader << Header;
+	}
+
+	// A raw image
+	if (Header.Magic != FormatMagic) return true;
+
+	if (Header.Version > FormatVersion || Header.ImageSize < 0 || Header.ImageSize > MAX_int32)
+	{
+		UE_LOG(LogAutoSave, Error, TEXT("Unsupported save struct format version %d."), Header.Version);
+		return false;
+	}
+
+	const FName FormatName = GetFormatName((ESaveStructCompression)Header.Compression);
+
+	if (FormatName.IsNone() || !FCompression::IsFormatValid(FormatName))
+	{
+		UE_LOG(LogAutoSave, Error, TEXT("The compression format '%s' of the save struct is not available."), *FormatName.ToString());
+		return false;
+	}
+
+	OutBuffer.SetNumUninitialized(Header.ImageSize);
+
+	if (Header.Flags & FormatFlagChunked)
+	{
+		if (!DecodeChunks(FormatName, Data, DataSize, OutBuffer))
+		{
+			UE_LOG(LogAutoSave, Error, TEXT("Failed to decompress the save struct chunks with '%s'."), *FormatName.ToString());
+			return false;
+		}
+	}
+	else if (!FCompression::UncompressMemory(FormatName, OutBuffer.GetData(), OutBuffer.Num(), Data + FormatHeaderSize, (int32)(DataSize - FormatHeaderSize)))
+	{
+		UE_LOG(LogAutoSave, Error, TEXT("Failed to decompress the save struct with '%s'."), *FormatName.ToString());
+		return false;
+	}
+
+	OutImage = OutBuffer.GetData();
+	OutImageSize = OutBuffer.Num();
+
+	return true;
+}
+
+FSaveStructStreamWriter::FSaveStructStreamWriter(const FString& InFilename, ESaveStructCompression InCompression, int32 InChunkSize)
+	: Filename(InFilename)
+	, TempFilename(InFilename + TEXT(".tmp"))
+	, Compression(InCompression)
+	, FormatName(FSaveStructFormat::IsCompressionAvailable(InCompression) ? FSaveStructFormat::GetFormatName(InCompression) : NAME_None)
+	, ChunkSize(FMath::Max(InChunkSize, 1))
+{
+	SetIsSaving(true);
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(Filename));
+
+	FileHandle.Reset(PlatformFile.OpenWrite(*TempFilename));
+
+	if (!FileHandle)
+	{
+		SetError();
+		return;
+	}
+
+	Chunk.Reserve(ChunkSize);
+
+	// The header is written again by Commit, once the size of the image is known
+	if (!FormatName.IsNone())
+	{
+		uint8 HeaderBuffer[FormatHeaderSize] = { };
+
+		if (!FileHandle->Write(HeaderBuffer, FormatHeaderSize))
+		{
+			SetError();
+			return;
+		}
+
+		FileSize = FormatHeaderSize;
+	}
+}
+
+FSaveStructStreamWriter::~FSaveStructStreamWriter()
+{
+	FileHandle.Reset();
+
+	if (!bCommitted)
+	{
+		IFileManager::Get().Delete(*TempFilename, false, false, true);
+	}
+}
+
+bool FSaveStructStreamWriter::Commit(bool bDurable)
+{
+	if (IsError() || !FlushChunk()) return false;
+
+	if (FormatName.IsNone())
+	{
+		FileSize = ImageSize;
+	}
+	else
+	{
+		FFormatHeader Header;
+		Header.Compression = (uint8)Compression;
+		Header.Flags = FormatFlagChunked;
+		Header.ImageSize = ImageSize;
+
+		TArray<uint8> HeaderBuffer;
+		FMemoryWriter Writer(HeaderBuffer);
+		Writer << Header;
+
+		if (!FileHandle->Seek(0) || !FileHandle->Write(HeaderBuffer.GetData(), HeaderBuffer.Num())) return false;
+	}
+
+	if (bDurable && !FileHandle->Flush(true)) return false;
+
+	FileHandle.Reset();
+
+	if (!IFileManager::Get().Move(*Filename, *TempFilename, true, true)) return false;
+
+	bCommitted = true;
+
+	return true;
+}
+
+void FSaveStructStreamWriter::Serialize(void* Data, int64 Num)
+{
+	if (IsError()) return;
+
+	const uint8* Source = (const uint8*)Data;
+
+	while (Num > 0)
+	{
+		// The chunk is full and the position at its end
+		if (Position - ChunkOffset >= ChunkSize && !FlushChunk())
+		{
+			SetError();
+			return;
+		}
+
+		const int32 ChunkPosition = (int32)(Position - ChunkOffset);
+		const int32 CopySize = (int32)FMath::Min<int64>(Num, ChunkSize - ChunkPosition);
+
+		if (ChunkPosition + CopySize > Chunk.Num())
+		{
+			Chunk.SetNumUninitialized(ChunkPosition + CopySize, false);
+		}
+
+		FMemory::Memcpy(Chunk.GetData() + ChunkPosition, Source, CopySize);
+
+		Source += CopySize;
+		Num -= CopySize;
+		Position += CopySize;
+	}
+
+	ImageSize = FMath::Max(ImageSize, Position);
+}
+
+FArchive& FSaveStructStreamWriter::operator<<(FName& Name)
+{
+	FString NameString = Name.ToString();
+	*this << NameString;
+
+	return *this;
+}
+
+FArchive& FSaveStructStreamWriter::operator<<(UObject*& Object)
+{
+	// Not supported by the memory archives either
+	checkNoEntry();
+
+	return *this;
+}
+
+void FSaveStructStreamWriter::Seek(int64 InPos)
+{
+	if (IsError()) return;
+
+	if (InPos < 0 || InPos > ImageSize)
+	{
+		SetError();
+		return;
+	}
+
+	if (InPos < ChunkOffset || InPos > ChunkOffset + Chunk.Num())
+	{
+		// Compressed chunks cannot be patched once written
+		if (!FormatName.IsNone() || !FlushChunk() || !FileHandle->Seek(InPos))
+		{
+			UE_LOG(LogAutoSave, Error, TEXT("Failed to seek the save struct stream of '%s'."), *Filename);
+			SetError();
+			return;
+		}
+
+		ChunkOffset = InPos;
+	}
+
+	Position = InPos;
+}
+
+bool FSaveStructStreamWriter::FlushChunk()
+{
+	if (!FileHandle) return false;
+
+	if (!Chunk.Num()) return true;
+
+	if (FormatName.IsNone())
+	{
+		if (!FileHandle->Write(Chunk.GetData(), Chunk.Num())) return false;
+	}
+	else
+	{
+		int32 RawSize = Chunk.Num();
+		int32 StoredSize = FCompression::CompressMemoryBound(FormatName, RawSize);
+
+		CompressedChunk.SetNumUninitialized(ChunkHeaderSize + StoredSize, false);
+
+		const bool bCompressed = FCompression::CompressMemory(FormatName, CompressedChunk.GetData() + ChunkHeaderSize, StoredSize, Chunk.GetData(), RawSize);
+
+		// Incompressible chunks are stored raw
+		if (!bCompressed || StoredSize >= RawSize)
+		{
+			StoredSize = RawSize;
+			CompressedChunk.SetNumUninitialized(ChunkHeaderSize + StoredSize, false);
+			FMemory::Memcpy(CompressedChunk.GetData() + ChunkHeaderSize, Chunk.GetData(), RawSize);
+		}
+
+		CompressedChunk.SetNum(ChunkHeaderSize + StoredSize, false);
+
+		// Overwrites the front of the record
+		FMemoryWriter Writer(CompressedChunk);
+		Writer << RawSize << StoredSize;
+
+		if (!FileHandle->Write(CompressedChunk.GetData(), CompressedChunk.Num())) return false;
+
+		FileSize += CompressedChunk.Num();
+	}
+
+	ChunkOffset += Chunk.Num();
+	Chunk.Reset();
+
+	return true;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AutoSaveSubsystem.h"
+
+class IFileHandle;
+
+// The on disk format of a save struct image, an optional header followed by the possibly compressed image.
+// Files without the header are raw images, as written before compression was supported.
+// Images streamed to the file are compressed in chunks, each with the raw and stored size in front of it.
+struct FSaveStructFormat
+{
+	// Whether the codec is set and can be used on this platform
+	static bool IsCompressionAvailable(ESaveStructCompression Compression);
+
+	// Encode the serialized image, the image is stored raw when compression is disabled, unavailable or does not pay off
+	static void Encode(const TArray<uint8>& Image, ESaveStructCompression Compression, TArray<uint8>& OutData);
+
+	// Decode the content of a file in place, returns false if the image cannot be restored
+	static bool Decode(TArray<uint8>& InOutData);
+
+	// Decode without copying a raw image, OutImage points into the data, or into OutBuffer when the image was decompressed
+	static bool Decode(const uint8* Data, int64 DataSize, TArray<uint8>& OutBuffer, const uint8*& OutImage, int64& OutImageSize);
+
+	static FName GetFormatName(ESaveStructCompression Compression);
+
+};
+
+// Archive writing an image to a temporary file while it is serialized, so the image is never held in memory as a whole.
+// The image is buffered a chunk at a time, with a codec each chunk is compressed on its own and the writer cannot be seeked back
+// to a chunk already written, raw images are patched in the file instead. The previous file stays intact until Commit moves the new one over it.
+class FSaveStructStreamWriter : public FArchive
+{
+public:
+
+	FSaveStructStreamWriter(const FString& InFilename, ESaveStructCompression InCompression, int32 InChunkSize);
+
+	// Deletes the temporary file if it was not committed
+	virtual ~FSaveStructStreamWriter();
+
+	// Write the rest of the image and move the file in place, false if any of it failed
+	bool Commit(bool bDurable);
+
+	FORCEINLINE int64 GetFileSize() const { return FileSize; }
+
+	virtual void Serialize(void* Data, int64 Num) override;
+
+	virtual void Seek(int64 InPos) override;
+
+	virtual int64 Tell() override { return Position; }
+
+	virtual int64 TotalSize() override { return ImageSize; }
+
+	virtual FString GetArchiveName() const override { return TEXT("FSaveStructStreamWriter"); }
+
+	// Names are written as strings like FMemoryWriter does, so the image reads back with a memory reader
+	using FArchive::operator<<;
+
+	virtual FArchive& operator<<(FName& Name) override;
+
+	virtual FArchive& operator<<(UObject*& Object) override;
+
+private:
+
+	bool FlushChunk();
+
+	const FString Filename;
+
+	const FString TempFilename;
+
+	const ESaveStructCompression Compression;
+
+	// NAME_None writes a raw image
+	FName FormatName;
+
+	const int32 ChunkSize;
+
+	TUniquePtr<IFileHandle> FileHandle;
+
+	// The part of the image from ChunkOffset on that is not written yet
+	TArray<uint8> Chunk;
+
+	int64 ChunkOffset = 0;
+
+	TArray<uint8> CompressedChunk;
+
+	int64 Position = 0;
+
+	int64 ImageSize = 0;
+
+	int64 FileSize = 0;
+
+	bool bCommitted = false;
+
+};
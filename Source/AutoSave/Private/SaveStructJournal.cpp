@@ -0,0 +1,237 @@
+#include "SaveStructJournal.h"
+
+#include "AutoSaveLog.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace
+{
+	const uint32 JournalMagic = 0x4C4A5341; // 'ASJL'
+
+	const uint32 PropertyJournalMagic = 0x504A5341; // 'ASJP'
+
+	const int64 JournalHeaderSize = sizeof(uint32) + sizeof(uint64);
+
+	const int64 RecordHeaderSize = sizeof(int32) + sizeof(uint32);
+
+	// Unchanged bytes shorter than this do not split a run, the run header costs about as much
+	const int32 MinGapSize = 16;
+
+	template<typename T>
+	FORCEINLINE bool ReadValue(const TArray<uint8>& Buffer, int64& Offset, T& OutValue)
+	{
+		if (Offset + (int64)sizeof(T) > Buffer.Num()) return false;
+		FMemory::Memcpy(&OutValue, Buffer.GetData() + Offset, sizeof(T));
+		Offset += sizeof(T);
+		return true;
+	}
+
+	bool ApplyDelta(const TArray<uint8>& Journal, int64 Offset, int64 End, TArray<uint8>& Image)
+	{
+		int32 NewSize = 0;
+		int32 RunNum = 0;
+
+		if (!ReadValue(Journal, Offset, NewSize) || !ReadValue(Journal, Offset, RunNum)) return false;
+
+		if (NewSize < 0 || RunNum < 0) return false;
+
+		Image.SetNumZeroed(NewSize);
+
+		for (int32 RunIndex = 0; RunIndex < RunNum; ++RunIndex)
+		{
+			int32 RunOffset = 0;
+			int32 RunLength = 0;
+
+			if (!ReadValue(Journal, Offset, RunOffset) || !ReadValue(Journal, Offset, RunLength)) return false;
+
+			if (RunOffset < 0 || RunLength < 0 || (int64)RunOffset + RunLength > NewSize || Offset + RunLength > End) return false;
+
+			FMemory::Memcpy(Image.GetData() + RunOffset, Journal.GetData() + Offset, RunLength);
+			Offset += RunLength;
+		}
+
+		return Offset == End;
+	}
+}
+
+FString FSaveStructJournal::GetJournalFilename(const FString& Filename)
+{
+	return Filename + TEXT(".journal");
+}
+
+int64 FSaveStructJournal::Replay(const FString& Filename, uint64 BaseHash, TArray<uint8>& Image, TArray<TArray<uint8>>& OutPropertyDeltas, ESaveStructJournalFormat& OutFormat, bool& bOutAppendable)
+{
+	bOutAppendable = true;
+
+	TArray<uint8> Journal;
+
+	if (!FFileHelper::LoadFileToArray(Journal, *GetJournalFilename(Filename), FILEREAD_Silent)) return 0;
+
+	bOutAppendable = false;
+
+	int64 Offset = 0;
+	uint32 Magic = 0;
+	uint64 JournalBaseHash = 0;
+
+	if (!ReadValue(Journal, Offset, Magic) || !ReadValue(Journal, Offset, JournalBaseHash)) return Journal.Num();
+
+	if (Magic != JournalMagic && Magic != PropertyJournalMagic) return Journal.Num();
+
+	OutFormat = Magic == PropertyJournalMagic ? ESaveStructJournalFormat::Properties : ESaveStructJournalFormat::Bytes;
+
+	// The file was rewritten after the journal, everything in it is already part of the base
+	if (JournalBaseHash != BaseHash) return Journal.Num();
+
+	while (Offset < Journal.Num())
+	{
+		int32 PayloadSize = 0;
+		uint32 PayloadCrc = 0;
+
+		if (!ReadValue(Journal, Offset, PayloadSize) || !ReadValue(Journal, Offset, PayloadCrc)) break;
+
+		if (PayloadSize < 0 || Offset + PayloadSize > Journal.Num()) break;
+
+		if (FCrc::MemCrc32(Journal.GetData() + Offset, PayloadSize) != PayloadCrc) break;
+
+		if (OutFormat == ESaveStructJournalFormat::Properties)
+		{
+			OutPropertyDeltas.Emplace(Journal.GetData() + Offset, PayloadSize);
+		}
+		else if (!ApplyDelta(Journal, Offset, Offset + PayloadSize, Image)) break;
+
+		Offset += PayloadSize;
+	}
+
+	if (Offset == Journal.Num())
+	{
+		bOutAppendable = true;
+	}
+	else
+	{
+		UE_LOG(LogAutoSave, Warning, TEXT("The journal of Save Struct '%s' ends with a torn record, the last save is lost."), *Filename);
+	}
+
+	return Journal.Num();
+}
+
+void FSaveStructJournal::MakeDelta(const TArray<uint8>& OldImage, const TArray<uint8>& NewImage, TArray<uint8>& OutPayload)
+{
+	FMemoryWriter Writer(OutPayload);
+
+	int32 NewSize = NewImage.Num();
+	int32 RunNum = 0;
+
+	Writer << NewSize;
+
+	const int64 RunNumOffset = Writer.Tell();
+	Writer << RunNum;
+
+	const int32 CommonSize = FMath::Min(OldImage.Num(), NewImage.Num());
+
+	int32 Index = 0;
+
+	while (Index < NewSize)
+	{
+		// Skip the unchanged bytes
+		while (Index < CommonSize && OldImage[Index] == NewImage[Index]) ++Index;
+
+		if (Index >= NewSize) break;
+
+		int32 RunOffset = Index;
+		int32 RunEnd = Index + 1;
+
+		for (int32 Cursor = RunEnd; Cursor < NewSize && Cursor - RunEnd < MinGapSize; ++Cursor)
+		{
+			if (Cursor >= CommonSize || OldImage[Cursor] != NewImage[Cursor])
+			{
+				RunEnd = Cursor + 1;
+			}
+		}
+
+		int32 RunLength = RunEnd - RunOffset;
+
+		Writer << RunOffset;
+		Writer << RunLength;
+		Writer.Serialize(const_cast<uint8*>(NewImage.GetData()) + RunOffset, RunLength);
+
+		++RunNum;
+		Index = RunEnd;
+	}
+
+	Writer.Seek(RunNumOffset);
+	Writer << RunNum;
+}
+
+bool FSaveStructJournal::Append(const FString& Filename, uint64 BaseHash, ESaveStructJournalFormat Format, const TArray<uint8>& Payload, int64& InOutJournalSize, bool bDurable)
+{
+	const bool bNewJournal = InOutJournalSize == 0;
+
+	TUniquePtr<IFileHandle> FileHandle(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*GetJournalFilename(Filename), !bNewJournal));
+
+	if (!FileHandle) return false;
+
+	TArray<uint8> Record;
+	Record.Reserve(JournalHeaderSize + RecordHeaderSize + Payload.Num());
+
+	FMemoryWriter Writer(Record);
+
+	if (bNewJournal)
+	{
+		uint32 Magic = Format == ESaveStructJournalFormat::Properties ? PropertyJournalMagic : JournalMagic;
+		uint64 JournalBaseHash = BaseHash;
+
+		Writer << Magic;
+		Writer << JournalBaseHash;
+	}
+
+	int32 PayloadSize = Payload.Num();
+	uint32 PayloadCrc = FCrc::MemCrc32(Payload.GetData(), Payload.Num());
+
+	Writer << PayloadSize;
+	Writer << PayloadCrc;
+
+	Record.Append(Payload);
+
+	if (!FileHandle->Write(Record.GetData(), Record.Num())) return false;
+
+	if (bDurable && !FileHandle->Flush(true)) return false;
+
+	InOutJournalSize += Record.Num();
+
+	return true;
+}
+
+bool FSaveStructJournal::Compact(const FString& Filename, const TArray<uint8>& Image, bool bDurable)
+{
+	const FString TempFilename = Filename + TEXT(".tmp");
+
+	if (bDurable)
+	{
+		IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+		PlatformFile.CreateDirectoryTree(*FPaths::GetPath(TempFilename));
+
+		TUniquePtr<IFileHandle> FileHandle(PlatformFile.OpenWrite(*TempFilename));
+
+		if (!FileHandle || !FileHandle->Write(Image.GetData(), Image.Num()) || !FileHandle->Flush(true)) return false;
+	}
+	else if (!FFileHelper::SaveArrayToFile(Image, *TempFilename))
+	{
+		return false;
+	}
+
+	// Once the new base is in place, the stale journal no longer matches its hash, so a crash here loses nothing
+	if (!IFileManager::Get().Move(*Filename, *TempFilename, true, true)) return false;
+
+	Discard(Filename);
+
+	return true;
+}
+
+void FSaveStructJournal::Discard(const FString& Filename)
+{
+	IFileManager::Get().Delete(*GetJournalFilename(Filename), false, false, true);
+}
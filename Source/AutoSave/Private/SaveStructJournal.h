@@ -0,0 +1,28 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AutoSaveSubsystem.h"
+
+// Append-only log of deltas stored next to a save file, the file itself is the base image of the journal.
+// The header records the format, byte deltas apply to the image and property deltas to the struct loaded from it.
+struct FSaveStructJournal
+{
+	static FString GetJournalFilename(const FString& Filename);
+
+	// Replay the byte deltas onto the base image, the property deltas are returned in order to be applied to the loaded struct.
+	// Returns the size of the journal file, zero if there is none, OutFormat is left unchanged without a journal.
+	// bOutAppendable is false when the journal does not belong to the base or ends with a torn record.
+	static int64 Replay(const FString& Filename, uint64 BaseHash, TArray<uint8>& Image, TArray<TArray<uint8>>& OutPropertyDeltas, ESaveStructJournalFormat& OutFormat, bool& bOutAppendable);
+
+	// Encode the difference between the images as a journal record payload
+	static void MakeDelta(const TArray<uint8>& OldImage, const TArray<uint8>& NewImage, TArray<uint8>& OutPayload);
+
+	// Append a record to the journal, a new journal of the format is started when InOutJournalSize is zero, a durable record is flushed to the disk
+	static bool Append(const FString& Filename, uint64 BaseHash, ESaveStructJournalFormat Format, const TArray<uint8>& Payload, int64& InOutJournalSize, bool bDurable);
+
+	// Replace the file with the image and discard the journal, a durable image is flushed to the disk before it is moved in place
+	static bool Compact(const FString& Filename, const TArray<uint8>& Image, bool bDurable);
+
+	static void Discard(const FString& Filename);
+
+};
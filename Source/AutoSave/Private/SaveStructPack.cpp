@@ -0,0 +1,486 @@
+#include "SaveStructPack.h"
+
+#include "AutoSaveLog.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace
+{
+	const uint32 PackMagic = 0x4B505341; // 'ASPK'
+
+	// Magic, Sequence, Capacity, Size, Crc, KeyLength
+	const int64 RecordHeaderSize = 32;
+
+	// Read at a time when looking for the next record behind a corrupted header
+	const int64 ScanChunkSize = 64 * 1024;
+
+	// Remainders smaller than this stay with the allocated block instead of becoming a free block
+	const int64 MinSplitSize = RecordHeaderSize + 64;
+
+	// Fragmentation is tolerated below this size, defragmenting a small pack is not worth the rewrite
+	const int64 MinDefragmentSize = 1024 * 1024;
+
+	struct FRecordHeader
+	{
+		uint32 Magic = PackMagic;
+		uint64 Sequence = 0;
+		int64 Capacity = 0;
+		int32 Size = -1;
+		uint32 Crc = 0;
+		int32 KeyLength = 0;
+
+		friend FArchive& operator<<(FArchive& Ar, FRecordHeader& Header)
+		{
+			return Ar << Header.Magic << Header.Sequence << Header.Capacity << Header.Size << Header.Crc << Header.KeyLength;
+		}
+	};
+
+	// Leave room for the record to grow a little before it has to move
+	FORCEINLINE int64 GetRecordCapacity(int64 RecordSize)
+	{
+		return Align(RecordSize + RecordSize / 8, 64);
+	}
+
+	bool WriteHeader(IFileHandle& FileHandle, int64 Offset, FRecordHeader& Header)
+	{
+		TArray<uint8> Buffer;
+		FMemoryWriter Writer(Buffer);
+		Writer << Header;
+
+		check(Buffer.Num() == RecordHeaderSize);
+
+		return FileHandle.Seek(Offset) && FileHandle.Write(Buffer.GetData(), Buffer.Num());
+	}
+
+	bool ReadHeader(IFileHandle& FileHandle, int64 Offset, FRecordHeader& Header)
+	{
+		TArray<uint8> Buffer;
+		Buffer.SetNumUninitialized(RecordHeaderSize);
+
+		if (!FileHandle.Seek(Offset) || !FileHandle.Read(Buffer.GetData(), RecordHeaderSize)) return false;
+
+		FMemoryReader Reader(Buffer);
+		Reader << Header;
+
+		return Header.Magic == PackMagic && Header.Capacity >= RecordHeaderSize;
+	}
+
+	// Write the key and the payload behind the header, padded to the capacity of the block
+	bool WriteBody(IFileHandle& FileHandle, int64 Offset, int64 Capacity, const FTCHARToUTF8& Key, const uint8* Data, int32 Size)
+	{
+		TArray<uint8> Buffer;
+		Buffer.SetNumZeroed(Capacity - RecordHeaderSize);
+
+		FMemory::Memcpy(Buffer.GetData(), Key.Get(), Key.Length());
+		FMemory::Memcpy(Buffer.GetData() + Key.Length(), Data, Size);
+
+		return FileHandle.Seek(Offset + RecordHeaderSize) && FileHandle.Write(Buffer.GetData(), Buffer.Num());
+	}
+}
+
+FSaveStructPack::FSaveStructPack(const FString& InPackFilename, float InDefragmentRatio)
+	: PackFilename(InPackFilename)
+	, DefragmentRatio(InDefragmentRatio)
+{
+}
+
+FSaveStructPack::~FSaveStructPack()
+{
+}
+
+bool FSaveStructPack::Open()
+{
+	FScopeLock Lock(&CriticalSection);
+
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(PackFilename), true);
+
+	FileHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*PackFilename, true, true));
+
+	if (!FileHandle) return false;
+
+	{
+		FRWScopeLock IndexWriteLock(IndexLock, SLT_Write);
+		Index.Reset();
+	}
+	FreeBlocks.Reset();
+	FreeSize = 0;
+	LastSequence = 0;
+
+	const int64 PackSize = FileHandle->Size();
+
+	int64 Offset = 0;
+
+	TArray<ANSICHAR> KeyBuffer;
+
+	while (Offset + RecordHeaderSize <= PackSize)
+	{
+		FRecordHeader Header;
+
+		if (!ReadHeader(*FileHandle, Offset, Header) || Offset + Header.Capacity > PackSize)
+		{
+			const int64 NextOffset = FindNextRecord(Offset, PackSize);
+
+			// A record torn by a crash while appending, the space is reused by the next append
+			if (NextOffset == INDEX_NONE) break;
+
+			UE_LOG(LogAutoSave, Warning, TEXT("Skipped %lld corrupted bytes at offset %lld of the pack '%s'."), NextOffset - Offset, Offset, *PackFilename);
+
+			// The hole is reused once it reads as a free block
+			if (NextOffset - Offset >= RecordHeaderSize)
+			{
+				FreeBlock(Offset, NextOffset - Offset);
+			}
+
+			Offset = NextOffset;
+			continue;
+		}
+
+		LastSequence = FMath::Max(LastSequence, Header.Sequence);
+
+		if (Header.Size < 0 || Header.KeyLength < 0 || RecordHeaderSize + Header.KeyLength + Header.Size > Header.Capacity)
+		{
+			FreeBlocks.Add(FFreeBlock{ Offset, Header.Capacity });
+			FreeSize += Header.Capacity;
+			Offset += Header.Capacity;
+			continue;
+		}
+
+		KeyBuffer.SetNumUninitialized(Header.KeyLength);
+
+		if (!FileHandle->Read((uint8*)KeyBuffer.GetData(), Header.KeyLength)) break;
+
+		FUTF8ToTCHAR KeyConverter(KeyBuffer.GetData(), KeyBuffer.Num());
+		FString Key(KeyConverter.Length(), KeyConverter.Get());
+
+		FEntry* Existing = Index.Find(Key);
+
+		// A crash between writing a record and freeing its previous location leaves two copies, the newer one wins
+		if (Existing && Existing->Sequence > Header.Sequence)
+		{
+			FreeBlock(Offset, Header.Capacity);
+		}
+		else
+		{
+			if (Existing)
+			{
+				FreeBlock(Existing->Offset, Existing->Capacity);
+			}
+
+			FRWScopeLock IndexWriteLock(IndexLock, SLT_Write);
+			Index.Add(Key, FEntry{ Offset, Header.Capacity, Header.Size, Header.Crc, Header.Sequence });
+		}
+
+		Offset += Header.Capacity;
+	}
+
+	FileSize = Offset;
+
+	return true;
+}
+
+bool FSaveStructPack::Contains(const FString& Key) const
+{
+	FRWScopeLock IndexReadLock(IndexLock, SLT_ReadOnly);
+
+	return Index.Contains(Key);
+}
+
+bool FSaveStructPack::Read(const FString& Key, TArray<uint8>& OutData) const
+{
+	FScopeLock Lock(&CriticalSection);
+
+	const FEntry* Entry = Index.Find(Key);
+
+	if (!FileHandle || !Entry) return false;
+
+	const int64 DataOffset = Entry->Offset + RecordHeaderSize + FTCHARToUTF8(*Key).Length();
+
+	OutData.SetNumUninitialized(Entry->Size);
+
+	if (!FileHandle->Seek(DataOffset) || !FileHandle->Read(OutData.GetData(), Entry->Size)) return false;
+
+	if (FCrc::MemCrc32(OutData.GetData(), OutData.Num()) != Entry->Crc)
+	{
+		UE_LOG(LogAutoSave, Error, TEXT("Save Struct '%s' in the pack '%s' is corrupted."), *Key, *PackFilename);
+		return false;
+	}
+
+	return true;
+}
+
+bool FSaveStructPack::Write(const FString& Key, const TArray<uint8>& Data, bool bDurable)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	if (!WriteRecord(Key, Data)) return false;
+
+	if (bDurable && !FileHandle->Flush(true)) return false;
+
+	if (ShouldDefragment())
+	{
+		Lock.Unlock();
+		Defragment();
+	}
+
+	return true;
+}
+
+void FSaveStructPack::WriteBatch(TArray<FBatchRecord>& Records, bool bDurable)
+{
+	FScopeLock Lock(&CriticalSection);
+
+	for (FBatchRecord& Record : Records)
+	{
+		Record.bWritten = WriteRecord(*Record.Key, *Record.Data);
+	}
+
+	// The records only count as written once they are on the disk
+	if (bDurable && FileHandle && !FileHandle->Flush(true))
+	{
+		for (FBatchRecord& Record : Records)
+		{
+			Record.bWritten = false;
+		}
+	}
+
+	if (ShouldDefragment())
+	{
+		Lock.Unlock();
+		Defragment();
+	}
+}
+
+bool FSaveStructPack::WriteRecord(const FString& Key, const TArray<uint8>& Data)
+{
+	if (!FileHandle) return false;
+
+	const FTCHARToUTF8 KeyConverter(*Key);
+
+	FRecordHeader Header;
+	Header.Sequence = ++LastSequence;
+	Header.Size = Data.Num();
+	Header.Crc = FCrc::MemCrc32(Data.GetData(), Data.Num());
+	Header.KeyLength = KeyConverter.Length();
+
+	const int64 PreviousFileSize = FileSize;
+
+	const int64 Offset = Allocate(RecordHeaderSize + Header.KeyLength + Header.Size, Header.Capacity);
+
+	// The header goes last, until then the block is still free or beyond the end of the pack
+	if (!WriteBody(*FileHandle, Offset, Header.Capacity, KeyConverter, Data.GetData(), Data.Num()) || !WriteHeader(*FileHandle, Offset, Header))
+	{
+		// Give the space back, a partly written append is overwritten by the next one
+		if (Offset >= PreviousFileSize)
+		{
+			FileSize = PreviousFileSize;
+		}
+		else
+		{
+			FreeBlock(Offset, Header.Capacity);
+		}
+
+		return false;
+	}
+
+	if (FEntry* Existing = Index.Find(Key))
+	{
+		FreeBlock(Existing->Offset, Existing->Capacity);
+	}
+
+	FRWScopeLock IndexWriteLock(IndexLock, SLT_Write);
+	Index.Add(Key, FEntry{ Offset, Header.Capacity, Header.Size, Header.Crc, Header.Sequence });
+
+	return true;
+}
+
+bool FSaveStructPack::IsValidRecord(int64 Offset, int64 PackSize) const
+{
+	FRecordHeader Header;
+
+	if (!ReadHeader(*FileHandle, Offset, Header) || Offset + Header.Capacity > PackSize) return false;
+
+	// Free blocks carry nothing to check
+	if (Header.Size < 0) return Header.Size == -1 && Header.KeyLength == 0 && Header.Crc == 0;
+
+	if (Header.KeyLength < 0 || RecordHeaderSize + Header.KeyLength + Header.Size > Header.Capacity) return false;
+
+	TArray<uint8> Data;
+	Data.SetNumUninitialized(Header.Size);
+
+	if (!FileHandle->Seek(Offset + RecordHeaderSize + Header.KeyLength) || !FileHandle->Read(Data.GetData(), Data.Num())) return false;
+
+	return FCrc::MemCrc32(Data.GetData(), Data.Num()) == Header.Crc;
+}
+
+int64 FSaveStructPack::FindNextRecord(int64 Offset, int64 PackSize) const
+{
+	TArray<uint8> Buffer;
+
+	// Records split off a free block start anywhere, so every byte is a candidate
+	for (int64 ChunkOffset = Offset + 1; ChunkOffset + RecordHeaderSize <= PackSize; ChunkOffset += ScanChunkSize)
+	{
+		// Overlap the next chunk by the rest of the magic
+		const int64 ReadSize = FMath::Min<int64>(ScanChunkSize + sizeof(PackMagic) - 1, PackSize - ChunkOffset);
+
+		Buffer.SetNumUninitialized(ReadSize);
+
+		if (!FileHandle->Seek(ChunkOffset) || !FileHandle->Read(Buffer.GetData(), ReadSize)) return INDEX_NONE;
+
+		for (int64 BufferIndex = 0; BufferIndex < ScanChunkSize && BufferIndex + (int64)sizeof(PackMagic) <= ReadSize; ++BufferIndex)
+		{
+			uint32 Magic = 0;
+			FMemory::Memcpy(&Magic, Buffer.GetData() + BufferIndex, sizeof(Magic));
+
+			if (Magic == PackMagic && IsValidRecord(ChunkOffset + BufferIndex, PackSize)) return ChunkOffset + BufferIndex;
+		}
+	}
+
+	return INDEX_NONE;
+}
+
+bool FSaveStructPack::ShouldDefragment() const
+{
+	return FileSize > MinDefragmentSize && FreeSize > FileSize * DefragmentRatio;
+}
+
+bool FSaveStructPack::Defragment()
+{
+	FScopeLock Lock(&CriticalSection);
+
+	if (!FileHandle) return false;
+
+	const FString TempFilename = PackFilename + TEXT(".tmp");
+
+	TMap<FString, FEntry> NewIndex;
+
+	{
+		TUniquePtr<IFileHandle> TempHandle(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*TempFilename));
+
+		if (!TempHandle) return false;
+
+		int64 Offset = 0;
+
+		TArray<uint8> Data;
+
+		for (const TPair<FString, FEntry>& Entry : Index)
+		{
+			const FTCHARToUTF8 KeyConverter(*Entry.Key);
+
+			Data.SetNumUninitialized(Entry.Value.Size);
+
+			if (!FileHandle->Seek(Entry.Value.Offset + RecordHeaderSize + KeyConverter.Length())) return false;
+			if (!FileHandle->Read(Data.GetData(), Data.Num())) return false;
+
+			FRecordHeader Header;
+			Header.Sequence = Entry.Value.Sequence;
+			Header.Capacity = GetRecordCapacity(RecordHeaderSize + KeyConverter.Length() + Data.Num());
+			Header.Size = Entry.Value.Size;
+			Header.Crc = Entry.Value.Crc;
+			Header.KeyLength = KeyConverter.Length();
+
+			if (!WriteBody(*TempHandle, Offset, Header.Capacity, KeyConverter, Data.GetData(), Data.Num())) return false;
+			if (!WriteHeader(*TempHandle, Offset, Header)) return false;
+
+			NewIndex.Add(Entry.Key, FEntry{ Offset, Header.Capacity, Header.Size, Header.Crc, Header.Sequence });
+
+			Offset += Header.Capacity;
+		}
+
+		// The pack is replaced by the move, the records have to be on the disk before that
+		if (!TempHandle->Flush(true)) return false;
+	}
+
+	FileHandle.Reset();
+
+	const bool bMoved = IFileManager::Get().Move(*PackFilename, *TempFilename, true, true);
+
+	if (!bMoved)
+	{
+		UE_LOG(LogAutoSave, Error, TEXT("Failed to replace the pack '%s' after defragmenting."), *PackFilename);
+		IFileManager::Get().Delete(*TempFilename, false, false, true);
+	}
+
+	FileHandle.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*PackFilename, true, true));
+
+	if (!FileHandle || !bMoved) return false;
+
+	{
+		FRWScopeLock IndexWriteLock(IndexLock, SLT_Write);
+		Index = MoveTemp(NewIndex);
+	}
+
+	FreeBlocks.Reset();
+	FreeSize = 0;
+	FileSize = FileHandle->Size();
+
+	return true;
+}
+
+bool FSaveStructPack::WriteFreeHeader(int64 Offset, int64 Capacity)
+{
+	FRecordHeader Header;
+	Header.Capacity = Capacity;
+
+	return WriteHeader(*FileHandle, Offset, Header);
+}
+
+void FSaveStructPack::FreeBlock(int64 Offset, int64 Capacity)
+{
+	WriteFreeHeader(Offset, Capacity);
+
+	FreeBlocks.Add(FFreeBlock{ Offset, Capacity });
+	FreeSize += Capacity;
+}
+
+int64 FSaveStructPack::Allocate(int64 RecordSize, int64& OutCapacity)
+{
+	int32 BestIndex = INDEX_NONE;
+
+	for (int32 BlockIndex = 0; BlockIndex < FreeBlocks.Num(); ++BlockIndex)
+	{
+		if (FreeBlocks[BlockIndex].Capacity < RecordSize) continue;
+
+		if (BestIndex == INDEX_NONE || FreeBlocks[BlockIndex].Capacity < FreeBlocks[BestIndex].Capacity)
+		{
+			BestIndex = BlockIndex;
+		}
+	}
+
+	if (BestIndex == INDEX_NONE)
+	{
+		const int64 Offset = FileSize;
+		OutCapacity = GetRecordCapacity(RecordSize);
+		FileSize += OutCapacity;
+		return Offset;
+	}
+
+	const FFreeBlock Block = FreeBlocks[BestIndex];
+	FreeBlocks.RemoveAtSwap(BestIndex, 1, false);
+	FreeSize -= Block.Capacity;
+
+	OutCapacity = Block.Capacity;
+
+	// Split the remainder off first, until the record header is written the whole block still reads as free
+	if (Block.Capacity - RecordSize >= MinSplitSize)
+	{
+		OutCapacity = RecordSize;
+
+		const FFreeBlock Remainder = { Block.Offset + RecordSize, Block.Capacity - RecordSize };
+
+		if (WriteFreeHeader(Remainder.Offset, Remainder.Capacity))
+		{
+			FreeBlocks.Add(Remainder);
+			FreeSize += Remainder.Capacity;
+		}
+		else
+		{
+			OutCapacity = Block.Capacity;
+		}
+	}
+
+	return Block.Offset;
+}
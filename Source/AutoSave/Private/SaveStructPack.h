@@ -0,0 +1,99 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "Misc/ScopeRWLock.h"
+
+class IFileHandle;
+
+// A single file holding many save structs addressed by their filename, safe to use from the worker threads
+class FSaveStructPack : public FNoncopyable
+{
+public:
+
+	FSaveStructPack(const FString& InPackFilename, float InDefragmentRatio);
+
+	~FSaveStructPack();
+
+	// Open or create the pack file and build the index from the record headers
+	bool Open();
+
+	// Never waits for the file access of the other threads
+	bool Contains(const FString& Key) const;
+
+	bool Read(const FString& Key, TArray<uint8>& OutData) const;
+
+	// Durable writes are flushed to the disk before returning
+	bool Write(const FString& Key, const TArray<uint8>& Data, bool bDurable = false);
+
+	struct FBatchRecord
+	{
+		const FString* Key;
+
+		const TArray<uint8>* Data;
+
+		bool bWritten;
+	};
+
+	// Write the records in one pass under the lock, a durable batch is flushed to the disk once at the end
+	void WriteBatch(TArray<FBatchRecord>& Records, bool bDurable);
+
+	// Rewrite the pack without the free blocks
+	bool Defragment();
+
+private:
+
+	struct FEntry
+	{
+		int64 Offset;
+		int64 Capacity;
+		int32 Size;
+		uint32 Crc;
+		uint64 Sequence;
+	};
+
+	struct FFreeBlock
+	{
+		int64 Offset;
+		int64 Capacity;
+	};
+
+	const FString PackFilename;
+
+	const float DefragmentRatio;
+
+	// Held for the file access, and over the index while it is read or changed with the file
+	mutable FCriticalSection CriticalSection;
+
+	TUniquePtr<IFileHandle> FileHandle;
+
+	// Changed under both locks, so the holder of the critical section reads it without the other one
+	mutable FRWLock IndexLock;
+
+	TMap<FString, FEntry> Index;
+
+	TArray<FFreeBlock> FreeBlocks;
+
+	int64 FileSize = 0;
+
+	int64 FreeSize = 0;
+
+	uint64 LastSequence = 0;
+
+	bool WriteRecord(const FString& Key, const TArray<uint8>& Data);
+
+	// Whether a valid free block or record with a matching checksum starts at the offset
+	bool IsValidRecord(int64 Offset, int64 PackSize) const;
+
+	// The first valid record behind a corrupted header, INDEX_NONE if there is none
+	int64 FindNextRecord(int64 Offset, int64 PackSize) const;
+
+	bool ShouldDefragment() const;
+
+	bool WriteFreeHeader(int64 Offset, int64 Capacity);
+
+	void FreeBlock(int64 Offset, int64 Capacity);
+
+	int64 Allocate(int64 RecordSize, int64& OutCapacity);
+
+};
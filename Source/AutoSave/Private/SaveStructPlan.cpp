@@ -0,0 +1,388 @@
+#include "SaveStructPlan.h"
+
+#include "Engine/UserDefinedStruct.h"
+#include "Hash/CityHash.h"
+#include "Serialization/LargeMemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/StructuredArchive.h"
+#include "UObject/UnrealType.h"
+
+namespace
+{
+	const uint32 PlanMagic = 0x4E505341; // 'ASPN'
+
+	// The magic as read from an image written with the other byte order
+	const uint32 SwappedPlanMagic = 0x4153504E;
+
+	// Magic, LittleEndian, SchemaHash, TableSize
+	const int32 PlanHeaderSize = 17;
+
+	// Values whose bytes are the whole value, bitfields are left to their property
+	bool IsPlainOldData(FProperty* Property)
+	{
+		if (CastField<FNumericProperty>(Property) || CastField<FEnumProperty>(Property)) return true;
+
+		if (FBoolProperty* BoolProperty = CastField<FBoolProperty>(Property)) return BoolProperty->IsNativeBool();
+
+		if (FStructProperty* StructProperty = CastField<FStructProperty>(Property)) return (StructProperty->Struct->StructFlags & STRUCT_IsPlainOldData) != 0;
+
+		return false;
+	}
+
+	// The C++ type, with the offset and type of each member of a struct, since the bytes of the members are copied as they are
+	FString DescribeType(FProperty* Property)
+	{
+		if (FEnumProperty* EnumProperty = CastField<FEnumProperty>(Property))
+		{
+			return EnumProperty->GetCPPType() + TEXT(":") + EnumProperty->GetUnderlyingProperty()->GetCPPType();
+		}
+
+		if (FBoolProperty* BoolProperty = CastField<FBoolProperty>(Property))
+		{
+			return FString::Printf(TEXT("%s/%u"), *BoolProperty->GetCPPType(), BoolProperty->GetFieldMask());
+		}
+
+		FStructProperty* StructProperty = CastField<FStructProperty>(Property);
+
+		if (!StructProperty) return Property->GetCPPType();
+
+		FString Result = FString::Printf(TEXT("%s(%d){"), *StructProperty->GetCPPType(), StructProperty->Struct->GetStructureSize());
+
+		for (TFieldIterator<FProperty> It(StructProperty->Struct); It; ++It)
+		{
+			Result += FString::Printf(TEXT("%s@%d:%s[%d];"), *It->GetName(), It->GetOffset_ForInternal(), *DescribeType(*It), It->ArrayDim);
+		}
+
+		return Result + TEXT("}");
+	}
+
+	FORCEINLINE bool CanRead(const FArchive& Ar, int64 Size)
+	{
+		return Size >= 0 && Ar.Tell() + Size <= Ar.TotalSize();
+	}
+}
+
+FSaveStructPlan::FSaveStructPlan(UScriptStruct* InStruct)
+	: Struct(InStruct)
+{
+	TArray<FProperty*> Properties;
+
+	for (TFieldIterator<FProperty> It(Struct); It; ++It)
+	{
+		Properties.Add(*It);
+	}
+
+	// Plain old data properties next to each other in memory become a single run
+	Properties.Sort([](const FProperty& A, const FProperty& B) { return A.GetOffset_ForInternal() < B.GetOffset_ForInternal(); });
+
+	FMemoryWriter TableWriter(Table);
+
+	int32 FieldNum = Properties.Num();
+	TableWriter << FieldNum;
+
+	for (FProperty* Property : Properties)
+	{
+		FField Field;
+		DescribeField(Property, Field);
+
+		uint8 Kind = (uint8)Field.Kind;
+		FString Name = Property->GetName();
+
+		TableWriter << Kind << Name << Field.Type << Field.Size;
+
+		const int32 Offset = Property->GetOffset_ForInternal();
+
+		if (Field.Kind == EFieldKind::Run && Steps.Num() && Steps.Last().Kind == EFieldKind::Run && Steps.Last().Offset + Steps.Last().Size == Offset)
+		{
+			Steps.Last().Size += Field.Size;
+			continue;
+		}
+
+		Steps.Add(FStep{ Field.Kind, Property, Offset, Field.Size });
+	}
+
+	SchemaHash = CityHash64((const char*)Table.GetData(), Table.Num());
+}
+
+bool FSaveStructPlan::CanUse(UScriptStruct* Struct)
+{
+	return !(Struct->StructFlags & STRUCT_SerializeNative) && !Struct->IsA<UUserDefinedStruct>();
+}
+
+bool FSaveStructPlan::IsPlanImage(const uint8* Image, int64 ImageSize)
+{
+	if (ImageSize < PlanHeaderSize) return false;
+
+	uint32 Magic = 0;
+	FMemory::Memcpy(&Magic, Image, sizeof(Magic));
+
+	// Images of the other byte order are recognized too, so they are rejected instead of read as tagged properties
+	return Magic == PlanMagic || Magic == SwappedPlanMagic;
+}
+
+void FSaveStructPlan::Serialize(const uint8* Data, FArchive& Writer) const
+{
+	uint32 Magic = PlanMagic;
+	uint8 LittleEndian = PLATFORM_LITTLE_ENDIAN;
+	uint64 Hash = SchemaHash;
+	int32 TableSize = Table.Num();
+
+	Writer << Magic << LittleEndian << Hash << TableSize;
+	Writer.Serialize(const_cast<uint8*>(Table.GetData()), TableSize);
+
+	uint8* Container = const_cast<uint8*>(Data);
+
+	TArray<uint8> ItemBuffer;
+
+	for (const FStep& Step : Steps)
+	{
+		switch (Step.Kind)
+		{
+		case EFieldKind::Run:
+			Writer.Serialize(Container + Step.Offset, Step.Size);
+			break;
+
+		case EFieldKind::Array:
+		{
+			FScriptArrayHelper Helper(CastFieldChecked<FArrayProperty>(Step.Property), Container + Step.Offset);
+
+			int32 Num = Helper.Num();
+			Writer << Num;
+
+			if (Num)
+			{
+				Writer.Serialize(Helper.GetRawPtr(0), Num * Step.Size);
+			}
+			break;
+		}
+
+		case EFieldKind::Item:
+		{
+			// The size in front of the item is filled in afterwards
+			ItemBuffer.Reset();
+
+			FMemoryWriter ItemWriter(ItemBuffer);
+			SerializeItem(ItemWriter, Step.Property, Container);
+
+			Writer.Serialize(ItemBuffer.GetData(), ItemBuffer.Num());
+			break;
+		}
+		}
+	}
+}
+
+bool FSaveStructPlan::Deserialize(const FSaveStructPlan* Plan, UScriptStruct* Struct, const uint8* Image, int64 ImageSize, uint8* Data)
+{
+	if (!IsPlanImage(Image, ImageSize)) return false;
+
+	FLargeMemoryReader Reader(Image, ImageSize);
+
+	uint32 Magic = 0;
+	uint8 LittleEndian = 0;
+	uint64 Hash = 0;
+	int32 TableSize = 0;
+
+	Reader << Magic << LittleEndian << Hash << TableSize;
+
+	// The plain old data is copied as is, so it is only readable with the byte order it was written with
+	if (Magic != PlanMagic || LittleEndian != PLATFORM_LITTLE_ENDIAN) return false;
+
+	if (!CanRead(Reader, TableSize)) return false;
+
+	const int64 BodyOffset = PlanHeaderSize + TableSize;
+
+	if (Plan && Plan->SchemaHash == Hash && Plan->Table.Num() == TableSize)
+	{
+		Reader.Seek(BodyOffset);
+
+		for (const FStep& Step : Plan->Steps)
+		{
+			switch (Step.Kind)
+			{
+			case EFieldKind::Run:
+				Reader.Serialize(Data + Step.Offset, Step.Size);
+				break;
+
+			case EFieldKind::Array:
+			{
+				int32 Num = 0;
+				Reader << Num;
+
+				if (!CanRead(Reader, (int64)Num * Step.Size)) return false;
+
+				FScriptArrayHelper Helper(CastFieldChecked<FArrayProperty>(Step.Property), Data + Step.Offset);
+				Helper.EmptyAndAddUninitializedValues(Num);
+
+				if (Num)
+				{
+					Reader.Serialize(Helper.GetRawPtr(0), Num * Step.Size);
+				}
+				break;
+			}
+
+			case EFieldKind::Item:
+				SerializeItem(Reader, Step.Property, Data);
+				break;
+			}
+
+			if (Reader.IsError()) return false;
+		}
+
+		return true;
+	}
+
+	// The layout has changed, the fields of the image are matched by name, the unmatched ones keep their values
+	FLargeMemoryReader TableReader(Image + PlanHeaderSize, TableSize);
+
+	Reader.Seek(BodyOffset);
+
+	int32 FieldNum = 0;
+	TableReader << FieldNum;
+
+	for (int32 FieldIndex = 0; FieldIndex < FieldNum; ++FieldIndex)
+	{
+		uint8 Kind = 0;
+		FString Name;
+		FString Type;
+		int32 Size = 0;
+
+		TableReader << Kind << Name << Type << Size;
+
+		if (TableReader.IsError()) return false;
+
+		FProperty* Property = Struct->FindPropertyByName(FName(*Name));
+
+		bool bMatched = false;
+
+		if (Property)
+		{
+			FField Field;
+			DescribeField(Property, Field);
+
+			bMatched = (uint8)Field.Kind == Kind && Field.Type == Type && Field.Size == Size;
+		}
+
+		switch ((EFieldKind)Kind)
+		{
+		case EFieldKind::Run:
+			if (!CanRead(Reader, Size)) return false;
+
+			if (bMatched)
+			{
+				Reader.Serialize(Property->ContainerPtrToValuePtr<uint8>(Data), Size);
+			}
+			else
+			{
+				Reader.Seek(Reader.Tell() + Size);
+			}
+			break;
+
+		case EFieldKind::Array:
+		{
+			int32 Num = 0;
+			Reader << Num;
+
+			if (!CanRead(Reader, (int64)Num * Size)) return false;
+
+			if (bMatched)
+			{
+				FScriptArrayHelper_InContainer Helper(CastFieldChecked<FArrayProperty>(Property), Data);
+				Helper.EmptyAndAddUninitializedValues(Num);
+
+				if (Num)
+				{
+					Reader.Serialize(Helper.GetRawPtr(0), Num * Size);
+				}
+			}
+			else
+			{
+				Reader.Seek(Reader.Tell() + (int64)Num * Size);
+			}
+			break;
+		}
+
+		case EFieldKind::Item:
+			if (bMatched)
+			{
+				SerializeItem(Reader, Property, Data);
+			}
+			else
+			{
+				int32 ItemSize = 0;
+				Reader << ItemSize;
+
+				if (!CanRead(Reader, ItemSize)) return false;
+
+				Reader.Seek(Reader.Tell() + ItemSize);
+			}
+			break;
+
+		default: return false;
+		}
+
+		if (Reader.IsError()) return false;
+	}
+
+	return true;
+}
+
+void FSaveStructPlan::DescribeField(FProperty* Property, FField& OutField)
+{
+	OutField.Property = Property;
+
+	if (IsPlainOldData(Property))
+	{
+		OutField.Kind = EFieldKind::Run;
+		OutField.Type = DescribeType(Property);
+		OutField.Size = Property->ElementSize * Property->ArrayDim;
+		return;
+	}
+
+	FArrayProperty* ArrayProperty = CastField<FArrayProperty>(Property);
+
+	if (ArrayProperty && ArrayProperty->ArrayDim == 1 && IsPlainOldData(ArrayProperty->Inner))
+	{
+		OutField.Kind = EFieldKind::Array;
+		OutField.Type = DescribeType(ArrayProperty->Inner);
+		OutField.Size = ArrayProperty->Inner->ElementSize;
+		return;
+	}
+
+	FString ExtendedType;
+
+	OutField.Kind = EFieldKind::Item;
+	OutField.Type = Property->GetCPPType(&ExtendedType) + ExtendedType;
+	OutField.Size = Property->ArrayDim;
+}
+
+void FSaveStructPlan::SerializeItem(FArchive& Ar, FProperty* Property, uint8* Data)
+{
+	// The size lets a reader of another layout skip the property
+	const int64 SizeOffset = Ar.Tell();
+
+	int32 Size = 0;
+	Ar << Size;
+
+	const int64 StartOffset = Ar.Tell();
+
+	for (int32 Index = 0; Index < Property->ArrayDim; ++Index)
+	{
+		FStructuredArchiveFromArchive StructuredArchive(Ar);
+		Property->SerializeItem(StructuredArchive.GetSlot(), Property->ContainerPtrToValuePtr<void>(Data, Index));
+	}
+
+	if (Ar.IsSaving())
+	{
+		const int64 EndOffset = Ar.Tell();
+
+		Size = EndOffset - StartOffset;
+
+		Ar.Seek(SizeOffset);
+		Ar << Size;
+		Ar.Seek(EndOffset);
+	}
+	else if (Ar.Tell() != StartOffset + Size)
+	{
+		Ar.SetError();
+	}
+}
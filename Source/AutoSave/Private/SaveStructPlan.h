@@ -0,0 +1,75 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Flattened serialization of the top-level properties of a struct, adjacent plain old data properties are copied as one run
+// and arrays of them in bulk, the other properties are serialized one by one. The image starts with a table of its fields,
+// so an image of another layout is still read by matching the fields by name and type. The types of plain old data include
+// the layout of their structs, so a nested struct that changed is not copied, and images of the other byte order are rejected.
+class FSaveStructPlan : public FNoncopyable
+{
+public:
+
+	explicit FSaveStructPlan(UScriptStruct* InStruct);
+
+	// Structs with native serializers and user defined structs, which can be recompiled, keep the tagged serialization
+	static bool CanUse(UScriptStruct* Struct);
+
+	static bool IsPlanImage(const uint8* Image, int64 ImageSize);
+
+	// The writer is never seeked back, the properties that are not plain old data are serialized aside before they are written
+	void Serialize(const uint8* Data, FArchive& Writer) const;
+
+	// The image is read with the plan if it has the same layout, and field by field otherwise, Plan may be null
+	static bool Deserialize(const FSaveStructPlan* Plan, UScriptStruct* Struct, const uint8* Image, int64 ImageSize, uint8* Data);
+
+private:
+
+	enum class EFieldKind : uint8
+	{
+		// Plain old data, copied as is
+		Run,
+
+		// Array of plain old data, the number of elements followed by the elements
+		Array,
+
+		// Anything else, the size of the serialized property followed by the property
+		Item,
+	};
+
+	struct FField
+	{
+		EFieldKind Kind;
+
+		FProperty* Property;
+
+		FString Type;
+
+		int32 Size;
+	};
+
+	struct FStep
+	{
+		EFieldKind Kind;
+
+		FProperty* Property;
+
+		int32 Offset;
+
+		int32 Size;
+	};
+
+	UScriptStruct* const Struct;
+
+	TArray<FStep> Steps;
+
+	// The serialized field table and its hash, the hash identifies the layout
+	TArray<uint8> Table;
+
+	uint64 SchemaHash = 0;
+
+	static void DescribeField(FProperty* Property, FField& OutField);
+
+	static void SerializeItem(FArchive& Ar, FProperty* Property, uint8* Data);
+
+};
@@ -0,0 +1,112 @@
+#include "SaveStructSnapshot.h"
+
+#include "UObject/UnrealType.h"
+
+namespace
+{
+	// Elements of a top-level array copied before the time is checked again
+	const int32 ElementChunkSize = 1024;
+}
+
+FSaveStructSnapshot::FSaveStructSnapshot(UScriptStruct* InStruct, const uint8* InSource, TArray<uint8>&& InBuffer)
+	: Struct(InStruct)
+	, Source(InSource)
+	, Buffer(MoveTemp(InBuffer))
+{
+	Buffer.SetNumUninitialized(Struct->GetStructureSize(), false);
+	Struct->InitializeStruct(Buffer.GetData());
+
+	for (TFieldIterator<FProperty> It(Struct); It; ++It)
+	{
+		Properties.Add(*It);
+	}
+}
+
+FSaveStructSnapshot::~FSaveStructSnapshot()
+{
+	if (Buffer.Num())
+	{
+		Struct->DestroyStruct(Buffer.GetData());
+	}
+}
+
+bool FSaveStructSnapshot::Step(double EndTime)
+{
+	while (!IsFinished())
+	{
+		FProperty* Property = Properties[PropertyIndex];
+		FArrayProperty* ArrayProperty = CastField<FArrayProperty>(Property);
+
+		if (ArrayProperty && ArrayProperty->ArrayDim == 1)
+		{
+			FScriptArrayHelper_InContainer SourceHelper(ArrayProperty, Source);
+			FScriptArrayHelper_InContainer DestHelper(ArrayProperty, Buffer.GetData());
+
+			if (ElementIndex == 0)
+			{
+				DestHelper.EmptyAndAddValues(SourceHelper.Num());
+			}
+
+			const int32 EndIndex = FMath::Min(ElementIndex + ElementChunkSize, SourceHelper.Num());
+
+			if (ArrayProperty->Inner->PropertyFlags & CPF_IsPlainOldData)
+			{
+				FMemory::Memcpy(DestHelper.GetRawPtr(ElementIndex), SourceHelper.GetRawPtr(ElementIndex), (EndIndex - ElementIndex) * ArrayProperty->Inner->ElementSize);
+				ElementIndex = EndIndex;
+			}
+			else
+			{
+				for (; ElementIndex < EndIndex; ++ElementIndex)
+				{
+					ArrayProperty->Inner->CopyCompleteValue(DestHelper.GetRawPtr(ElementIndex), SourceHelper.GetRawPtr(ElementIndex));
+				}
+			}
+
+			if (ElementIndex >= SourceHelper.Num())
+			{
+				++PropertyIndex;
+				ElementIndex = 0;
+			}
+		}
+		else
+		{
+			Property->CopyCompleteValue_InContainer(Buffer.GetData(), Source);
+			++PropertyIndex;
+		}
+
+		if (FPlatformTime::Seconds() >= EndTime) break;
+	}
+
+	return IsFinished();
+}
+
+void FSaveStructSnapshot::Finish()
+{
+	Step(MAX_dbl);
+}
+
+void FSaveStructSnapshot::Restart()
+{
+	Struct->DestroyStruct(Buffer.GetData());
+	Struct->InitializeStruct(Buffer.GetData());
+
+	PropertyIndex = 0;
+	ElementIndex = 0;
+}
+
+TArray<uint8> FSaveStructSnapshot::Release()
+{
+	check(IsFinished());
+
+	return MoveTemp(Buffer);
+}
+
+TArray<uint8> FSaveStructSnapshot::Abort()
+{
+	Struct->DestroyStruct(Buffer.GetData());
+
+	TArray<uint8> Result = MoveTemp(Buffer);
+	Result.Reset();
+
+	return Result;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// Deep copy of a struct made a few properties at a time on the game thread, the source must not change until it is finished
+class FSaveStructSnapshot : public FNoncopyable
+{
+public:
+
+	FSaveStructSnapshot(UScriptStruct* InStruct, const uint8* InSource, TArray<uint8>&& InBuffer);
+
+	~FSaveStructSnapshot();
+
+	// Copy until the end time is reached, at least one step is made, returns true when the copy is complete
+	bool Step(double EndTime);
+
+	void Finish();
+
+	// Drop the progress and copy from the start again
+	void Restart();
+
+	FORCEINLINE bool IsFinished() const { return PropertyIndex >= Properties.Num(); }
+
+	// Hand over the finished copy
+	TArray<uint8> Release();
+
+	// Hand over the buffer of an unfinished copy, the struct in it is destroyed
+	TArray<uint8> Abort();
+
+private:
+
+	UScriptStruct* const Struct;
+
+	const uint8* const Source;
+
+	TArray<uint8> Buffer;
+
+	TArray<FProperty*> Properties;
+
+	int32 PropertyIndex = 0;
+
+	// Top-level arrays are copied in chunks of elements
+	int32 ElementIndex = 0;
+
+};
@@ -1,6 +1,12 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Containers/List.h"
+#include "Containers/Queue.h"
+#include "HAL/Event.h"
+#include "HAL/CriticalSection.h"
+#include "HAL/ThreadSafeCounter64.h"
+#include "Misc/QueuedThreadPool.h"
 #include "Subsystems/GameInstanceSubsystem.h"
 #include "AutoSaveSubsystem.generated.h"
 
@@ -10,36 +16,256 @@ struct AUTOSAVE_API FSaveStruct { GENERATED_BODY() };
 UENUM(BlueprintType, Category = "AutoSave")
 enum class ESaveStructState : uint8
 {
+	Pending,
 	Preload,
 	Loading,
 	Idle,
 	Saving,
+	Failed,
+	Snapshotting,
+};
+
+UENUM(BlueprintType, Category = "AutoSave")
+enum class ESaveStructCompression : uint8
+{
+	None,
+	Zlib,
+	Gzip,
+	LZ4,
+	Oodle,
+};
+
+UENUM(BlueprintType, Category = "AutoSave")
+enum class ESaveStructJournalFormat : uint8
+{
+	// The byte runs that differ from the last persisted image
+	Bytes,
+
+	// The properties that differ from the last persisted struct, nested structs are compared field by field
+	Properties,
+};
+
+// Scheduling classes of the load and save tasks, in dispatch order
+UENUM(BlueprintType, Category = "AutoSave")
+enum class ESaveStructPriority : uint8
+{
+	CriticalLoad,
+	NormalLoad,
+	ReleaseSave,
+	PrefetchLoad,
+	BackgroundSave,
+	Num UMETA(Hidden),
+};
+
+// Latencies in power of two buckets of microseconds, bucket N counts [2^(N-1), 2^N) and bucket 0 less than a microsecond
+struct AUTOSAVE_API FAutoSaveLatencyHistogram
+{
+	static constexpr int32 BucketNum = 32;
+
+	void Add(double Seconds);
+
+	int64 GetNum() const;
+
+	// Upper bound in seconds of the bucket the percentile in [0, 1] falls into
+	double GetPercentile(float Percentile) const;
+
+	FORCEINLINE int64 GetBucketCount(int32 BucketIndex) const { return Buckets[BucketIndex].GetValue(); }
+
+private:
+
+	FThreadSafeCounter64 Buckets[BucketNum];
+};
+
+// Counters kept in every build configuration, cheap enough to be exported as telemetry
+struct AUTOSAVE_API FAutoSaveCounters
+{
+	// Updated by the workers
+
+	FThreadSafeCounter64 LoadNum;
+	FThreadSafeCounter64 SaveNum;
+	FThreadSafeCounter64 FailedNum;
+
+	// Saves skipped because the file already holds the same image
+	FThreadSafeCounter64 UnchangedSaveNum;
+
+	FThreadSafeCounter64 BytesRead;
+	FThreadSafeCounter64 BytesWritten;
+
+	// From added to the pool to started by a worker
+	FAutoSaveLatencyHistogram QueueWaitLatency;
+
+	// The rest of the task, serializing, compressing and hashing in either direction
+	FAutoSaveLatencyHistogram SerializeLatency;
+
+	// Reading and writing the files, the journals and the pack
+	FAutoSaveLatencyHistogram IOLatency;
+
+	// Updated by the game thread
+
+	int64 ResidentHitNum = 0;
+	int64 ResidentMissNum = 0;
+
+	int64 CompletedTaskNum[(int32)ESaveStructPriority::Num] = { };
+	int64 DeadlineMissNum[(int32)ESaveStructPriority::Num] = { };
+
+	// Time spent to start, snapshot and finish the tasks, each task is counted once when it starts
+	uint64 GameThreadTaskCycles = 0;
+	int64 GameThreadTaskNum = 0;
+
+	// Times the save backlog rose beyond UAutoSaveSubsystem::SaveBacklogThreshold
+	int64 BackpressureNum = 0;
+};
+
+// Payload storage of the structs in memory, see UAutoSaveSubsystem::PayloadCacheBudget
+struct AUTOSAVE_API FAutoSavePayloadStats
+{
+	int64 AllocationNum = 0;
+
+	// Allocations served by a cached block of the size class
+	int64 ReusedNum = 0;
+
+	int64 LiveBlockNum = 0;
+
+	// Bytes handed out, rounded up to the size classes
+	int64 LiveSize = 0;
+
+	// Bytes of the freed blocks kept for reuse
+	int64 CachedSize = 0;
+};
+
+USTRUCT(BlueprintType)
+struct AUTOSAVE_API FSaveStructPrefetchRequest
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AutoSave")
+	FString Filename;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AutoSave")
+	UScriptStruct* ScriptStruct = nullptr;
+};
+
+DECLARE_DELEGATE_OneParam(FSaveStructLoadDelegate, const FString&);
+DECLARE_MULTICAST_DELEGATE_OneParam(FSaveStructLoadDelegates, const FString&);
+
+DECLARE_DYNAMIC_DELEGATE_OneParam(FSaveStructLoadDynamicDelegate, const FString&, Filename);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FSaveStructLoadDynamicDelegates, const FString&, Filename);
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FAutoSaveBackpressureDelegate, bool);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FAutoSaveBackpressureDynamicDelegate, bool, bBackpressure);
+
+// Refers to a struct in memory without the filename, it goes stale once the struct is removed from memory
+USTRUCT(BlueprintType)
+struct AUTOSAVE_API FSaveStructHandle
+{
+	GENERATED_BODY()
+
+	// Slot of the struct in UAutoSaveSubsystem, and the generation of the slot when the handle was made
+	UPROPERTY()
+	int32 Index = INDEX_NONE;
+
+	UPROPERTY()
+	int32 Generation = 0;
+
+	FORCEINLINE bool IsValid() const { return Index != INDEX_NONE; }
+
+	FORCEINLINE bool operator==(const FSaveStructHandle& Other) const { return Index == Other.Index && Generation == Other.Generation; }
+
+	FORCEINLINE bool operator!=(const FSaveStructHandle& Other) const { return !(*this == Other); }
+
+	FORCEINLINE friend uint32 GetTypeHash(const FSaveStructHandle& Handle) { return HashCombine(GetTypeHash(Handle.Index), GetTypeHash(Handle.Generation)); }
 };
 
 struct AUTOSAVE_API FSaveStructInfo
 {
 	FString Filename;
 
+	FSaveStructHandle Handle;
+
 	UScriptStruct* Struct;
 
 	ESaveStructState State;
 
+	ESaveStructCompression Compression;
+
 	int32 RefConut;
 
 	int32 LastRefConut;
 
 	FDateTime LastSaveTime;
 
-	TArray<uint8> Data;
-	// FSaveStruct* Data;
+	// Whether the struct was modified since the last save, only consulted when UAutoSaveSubsystem::bExplicitDirtyTracking is enabled
+	bool bDirty;
 
-};
+	// Fingerprint of the image last read from or written to the file, a save with the same image skips the write
+	bool bHasSavedHash;
+	uint64 SavedHash;
 
-DECLARE_DELEGATE_OneParam(FSaveStructLoadDelegate, const FString&);
-DECLARE_MULTICAST_DELEGATE_OneParam(FSaveStructLoadDelegates, const FString&);
+	// Journaled storage, the image persisted by the file together with its journal, see UAutoSaveSubsystem::bJournaledStorage
+	TArray<uint8> JournalImage;
+	uint64 JournalBaseHash;
+	int64 JournalBaseSize;
 
-DECLARE_DYNAMIC_DELEGATE_OneParam(FSaveStructLoadDynamicDelegate, const FString&, Filename);
-DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FSaveStructLoadDynamicDelegates, const FString&, Filename);
+	// Size of the journal on disk, and whether the next save may append to it instead of compacting
+	int64 JournalSize;
+	bool bJournalAppendable;
+
+	// Property journals, the struct as persisted by the file together with its journal
+	TArray<uint8> JournalStruct;
+
+	// Order among the prefetched structs, higher loads first
+	int32 PrefetchPriority;
+
+	// Class of the queued task and the time it was requested, the deadline of the class counts from then
+	ESaveStructPriority Priority;
+	FDateTime RequestTime;
+
+	// Size of the serialized image last read or written
+	int64 ImageSize;
+
+	// Called once the struct is loaded or has failed, see UAutoSaveSubsystem::HandleLoadDelegates
+	FSaveStructLoadDelegates LoadDelegates;
+	FSaveStructLoadDynamicDelegates LoadDynamicDelegates;
+
+	// Group whose members are saved together, NAME_None for none
+	FName SaveGroup;
+
+	// Serialization plan shared by the structs of the same type, null for the tagged serialization
+	TSharedPtr<class FSaveStructPlan> Plan;
+
+	// Node in the resident list while the struct is kept in memory without references
+	TDoubleLinkedList<FSaveStructInfo*>::TDoubleLinkedListNode* ResidentNode;
+	int64 ResidentSize;
+
+	// Scheduling partition, see UAutoSaveSubsystem::AddSaveStructPartition, and the index among its members
+	int32 PartitionIndex;
+	int32 PartitionMemberIndex;
+
+	// Aligned to UScriptStruct::GetMinAlignment, allocated by UAutoSaveSubsystem::PayloadAllocator
+	uint8* Data;
+
+	// The size and alignment the data was allocated with, the struct may change in the editor while it is allocated
+	int32 DataSize;
+	int32 DataAlignment;
+
+	// Guards the data against the worker threads, see FSaveStructReadScope and FSaveStructWriteScope
+	FRWLock DataLock;
+
+	// Bumped by each write scope, compared with the value seen by the last snapshot
+	FThreadSafeCounter WriteSerial;
+	int32 SnapshotWriteSerial;
+
+	~FSaveStructInfo()
+	{
+		if (JournalStruct.Num())
+		{
+			Struct->DestroyStruct(JournalStruct.GetData());
+		}
+	}
+
+	FORCEINLINE bool IsLoaded() const { return State == ESaveStructState::Idle || State == ESaveStructState::Saving || State == ESaveStructState::Snapshotting; }
+
+};
 
 UCLASS(Config = Engine, DefaultConfig)
 class AUTOSAVE_API UAutoSaveSubsystem : public UGameInstanceSubsystem, public FTickableGameObject
@@ -58,61 +284,654 @@ public:
 
 	UPROPERTY(Config, EditAnywhere, Category = "AutoSave")
 	FTimespan SaveWaitTime = FTimespan(ETimespan::MaxTicks);
+
+	// Only save the structs marked dirty, the modifications must be reported by MarkSaveStructDirty or FSaveStructPtr::MarkDirty
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave")
+	bool bExplicitDirtyTracking = false;
+
+	// Append the changes of each save to a journal next to the file instead of rewriting the whole file
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave")
+	bool bJournaledStorage = false;
+
+	// Property deltas skip the serialization of the unchanged properties, byte deltas also work for structs with native serializers
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave", meta = (EditCondition = "bJournaledStorage"))
+	ESaveStructJournalFormat JournalFormat = ESaveStructJournalFormat::Bytes;
+
+	// The journal is compacted into the file once it grows beyond this ratio of the file size
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave", meta = (EditCondition = "bJournaledStorage", ClampMin = "0.0"))
+	float JournalCompactionRatio = 1.0f;
+
+	// Store all save structs as records of a single pack file, the filenames become the keys of the records
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave")
+	bool bPackedStorage = false;
+
+	// Relative to the project saved directory
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave", meta = (EditCondition = "bPackedStorage"))
+	FString PackFilename = TEXT("AutoSave/AutoSave.pack");
+
+	// The pack is defragmented once the free space exceeds this ratio of the pack size
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave", meta = (EditCondition = "bPackedStorage", ClampMin = "0.0"))
+	float PackDefragmentRatio = 0.5f;
+
+	// Serialize the structs with a plan cached per struct type, plain old data is copied in bulk instead of property by property.
+	// The images describe their fields, so they stay readable when the struct changes, and with this setting disabled.
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave")
+	bool bSerializationPlans = false;
+
+	// Compress the save structs on the worker threads, the files record the codec so they load with any setting
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave")
+	ESaveStructCompression Compression = ESaveStructCompression::None;
+
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave")
+	TMap<TSoftObjectPtr<UScriptStruct>, ESaveStructCompression> StructCompression;
+
+	// Memory in bytes for keeping released structs loaded, so acquiring them again does not wait for the disk
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave", meta = (ClampMin = "0"))
+	int64 ResidentCacheBudget = 0;
+
+	// Memory in bytes for keeping the payloads of removed structs, so structs of similar size reuse them instead of the heap
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave", meta = (ClampMin = "0"))
+	int64 PayloadCacheBudget = 4 * 1024 * 1024;
+
+	// Task threads only loads may use, so urgent loads do not wait behind the saves, at least one thread is left to the saves
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave", meta = (ClampMin = "0"))
+	int32 ReservedLoadThreadNum = 1;
+
+	// Latency from request to completion each class should stay within, a missed deadline is counted and logged
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave")
+	TMap<ESaveStructPriority, FTimespan> PriorityDeadlines;
+
+	// Structs whose last image reached this size in bytes are snapshotted across frames instead of at once, zero disables it.
+	// Needs bExplicitDirtyTracking, a modification must be reported before it is made while the snapshot is taken, as FSaveStructPtr::GetMutable does.
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave", meta = (EditCondition = "bExplicitDirtyTracking", ClampMin = "0"))
+	int64 IncrementalSnapshotSize = 0;
+
+	// Files of at least this size in bytes are deserialized straight from a memory mapping instead of being read into memory first, zero disables it.
+	// Files with a journal, byte journaled storage and the pack are always read, as are the files of platforms that cannot map them.
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave", meta = (ClampMin = "0"))
+	int64 MappedLoadSize = 0;
+
+	// Structs whose last image reached this size in bytes are serialized straight into a temporary file a chunk at a time, zero disables it.
+	// Compressed images are only streamed with bSerializationPlans, which write forward only. Journaled storage, the pack and batched saves
+	// keep the image in memory. Streamed images are not hashed, so they are written even if nothing has changed.
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave", meta = (ClampMin = "0"))
+	int64 StreamingSaveSize = 0;
+
+	// Size in bytes of the chunks of a streamed save, the memory it needs besides the snapshot, and each compressed on its own
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave", meta = (ClampMin = "4096"))
+	int32 StreamingChunkSize = 256 * 1024;
+
+	// Game thread time per frame spent on the snapshots across frames
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave", meta = (EditCondition = "bExplicitDirtyTracking"))
+	FTimespan SnapshotFrameBudget = FTimespan::FromMilliseconds(1.0);
+
+	// Due saves started together are serialized in parallel and written in one pass by a single task, 1 saves each struct on its own.
+	// Journaled saves append to their own journals and are only batched as members of a save group.
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave", meta = (ClampMin = "1"))
+	int32 SaveBatchSize = 1;
+
+	// A save only completes once the data is flushed to the disk, the pack is flushed once per batch.
+	// Moving the files of a group commit in place is not flushed, so their manifests are kept and the moves checked again at the next start.
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave")
+	bool bDurableSaves = false;
+
+	// Disk budget of the release and background saves in bytes and in files written per second, zero for no limit, flushes are exempt.
+	// The tasks start with the size of their last image charged, corrected by the actual size once done.
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave", meta = (ClampMin = "0"))
+	int64 SaveBytesPerSecond = 0;
+
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave", meta = (ClampMin = "0"))
+	int32 SaveOperationsPerSecond = 0;
+
+	// Budget of the normal and prefetch loads apart from the saves, critical loads are exempt
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave", meta = (ClampMin = "0"))
+	int64 LoadBytesPerSecond = 0;
+
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave", meta = (ClampMin = "0"))
+	int32 LoadOperationsPerSecond = 0;
+
+	// Saves due or released and not started yet beyond which backpressure is signaled, until the backlog is down to half of it, zero disables it
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave", meta = (ClampMin = "0"))
+	int32 SaveBacklogThreshold = 0;
+
+	// Called when the backpressure starts and ends, see SaveBacklogThreshold
+	FAutoSaveBackpressureDelegate OnSaveBackpressure;
+
+	UPROPERTY(BlueprintAssignable, Category = "AutoSave")
+	FAutoSaveBackpressureDynamicDelegate OnSaveBackpressureDynamic;
+
+	// The time the subsystem waits for the save structs when deinitialized, zero waits until all of them are saved
+	UPROPERTY(Config, EditAnywhere, Category = "AutoSave")
+	FTimespan ShutdownFlushDeadline = FTimespan::Zero();
 	
+	// Lists every struct, the counters and the AutoSave stat group are the cheaper way to watch the subsystem
 	UFUNCTION(BlueprintPure, Category = "AutoSave", meta = (DevelopmentOnly))
 	FString GetSaveStructDebugString() const;
 
 	UFUNCTION(BlueprintPure, Category = "AutoSave")
 	int32 GetIdleThreadNum() const;
 
-	FSaveStruct* AddSaveStructRef(const FString& Filename, UScriptStruct* ScriptStruct = nullptr);
+	// Average game thread seconds spent to start and finish a load or save task
+	UFUNCTION(BlueprintPure, Category = "AutoSave")
+	float GetGameThreadTimePerTask() const;
+
+	// Priority is CriticalLoad or NormalLoad, it raises the class of a struct that is still waiting to be loaded
+	FSaveStruct* AddSaveStructRef(const FString& Filename, UScriptStruct* ScriptStruct = nullptr, ESaveStructPriority Priority = ESaveStructPriority::NormalLoad);
 
-	FSaveStruct* AddSaveStructRef(const FString& Filename, UScriptStruct* ScriptStruct, FSaveStructLoadDelegate LoadCallback);
+	FSaveStruct* AddSaveStructRef(const FString& Filename, UScriptStruct* ScriptStruct, FSaveStructLoadDelegate LoadCallback, ESaveStructPriority Priority = ESaveStructPriority::NormalLoad);
 
-	FSaveStruct* AddSaveStructRef(const FString& Filename, UScriptStruct* ScriptStruct, FSaveStructLoadDynamicDelegate LoadCallback);
+	FSaveStruct* AddSaveStructRef(const FString& Filename, UScriptStruct* ScriptStruct, FSaveStructLoadDynamicDelegate LoadCallback, ESaveStructPriority Priority = ESaveStructPriority::NormalLoad);
 
 	void RemoveSaveStructRef(const FString& Filename);
+
+	void RemoveSaveStructRef(FSaveStructHandle Handle);
+
+	// Whether the struct is available, the load delegates are also called when loading failed
+	UFUNCTION(BlueprintPure, Category = "AutoSave")
+	bool IsSaveStructLoaded(const FString& Filename) const;
+
+	bool IsSaveStructLoaded(FSaveStructHandle Handle) const;
+
+	// The handle of a struct in memory, the handle operations look the struct up without hashing the filename
+	FSaveStructHandle GetSaveStructHandle(const FString& Filename) const;
+
+	// Null if the handle is stale, the struct is only usable once loaded
+	FSaveStruct* GetSaveStruct(FSaveStructHandle Handle) const;
+
+	void MarkSaveStructDirty(const FString& Filename);
+
+	void MarkSaveStructDirty(FSaveStructHandle Handle);
+
+	// The loaded members of a group are saved together whenever one of them is saved, with a file per struct they are committed all or nothing.
+	// Records of the pack are written in one pass but not atomically. The group lasts while the struct is in memory, NAME_None removes it.
+	void SetSaveStructGroup(const FString& Filename, FName Group);
+
+	FORCEINLINE const FAutoSaveCounters& GetCounters() const { return Counters; }
+
+	FORCEINLINE int64 GetResidentCacheHitNum() const { return Counters.ResidentHitNum; }
+
+	FORCEINLINE int64 GetResidentCacheMissNum() const { return Counters.ResidentMissNum; }
+
+	FORCEINLINE int64 GetCompletedTaskNum(ESaveStructPriority Priority) const { return Counters.CompletedTaskNum[(int32)Priority]; }
+
+	FORCEINLINE int64 GetDeadlineMissNum(ESaveStructPriority Priority) const { return Counters.DeadlineMissNum[(int32)Priority]; }
+
+	FORCEINLINE int32 GetStructNum() const { return StructInfos.Num(); }
+
+	// Entries waiting in the queues, including the stale ones and the saves that are not due yet
+	int32 GetQueuedTaskNum() const;
+
+	FORCEINLINE int32 GetInFlightTaskNum() const { return InFlightTaskNum; }
+
+	FORCEINLINE int64 GetResidentSize() const { return ResidentSize; }
+
+	FAutoSavePayloadStats GetPayloadStats() const;
+
+	// Struct infos the slabs have room for
+	int32 GetInfoPoolCapacity() const;
+
+	// Saves due or released and not started yet, held back by the thread pool or the save budget, including the stale entries of the release queues
+	UFUNCTION(BlueprintPure, Category = "AutoSave")
+	int32 GetSaveBacklogNum() const;
+
+	UFUNCTION(BlueprintPure, Category = "AutoSave")
+	bool IsSaveBackpressured() const { return bSaveBackpressure; }
+
+	// Load the structs in the background without holding references, a later AddSaveStructRef finds them loaded.
+	// Prefetched structs are kept by the resident cache, so ResidentCacheBudget has to be set. Returns the number of structs queued.
+	int32 PrefetchSaveStructs(const TArray<FSaveStructPrefetchRequest>& Requests, int32 Priority = 0);
+
+	// Save every loaded struct in parallel, returns the structs that could not be saved before the deadline
+	TArray<FString> FlushSaveStructs(FTimespan Deadline = FTimespan::Zero());
+
+	// Structs created from now on with a filename under the root directory are scheduled apart from the others, with queues of their own
+	// and at most MaxInFlightTaskNum tasks at once, zero for no limit. The partitions take turns starting their tasks, loads go first.
+	// The root is matched against the filenames as given. Adding the partition again updates the limit.
+	void AddSaveStructPartition(FName Partition, const FString& RootDirectory, int32 MaxInFlightTaskNum = 0);
+
+	// Like FlushSaveStructs for the structs of the partition, only the tasks of the partition are waited for
+	TArray<FString> FlushSaveStructPartition(FName Partition, FTimespan Deadline = FTimespan::Zero());
+
+	// Flush the partition and remove its structs without references from memory, the partition is removed with its last struct.
+	// Structs not saved before the deadline stay until they are saved, they are returned like by FlushSaveStructs.
+	TArray<FString> UnloadSaveStructPartition(FName Partition, FTimespan Deadline = FTimespan::Zero());
+
+	FORCEINLINE int32 GetSaveStructPartitionNum() const { return Partitions.Num(); }
+
+	// Structs of the partition in memory, zero for an unknown partition
+	int32 GetSaveStructPartitionStructNum(FName Partition) const;
 	
 private:
 
+	// Types of the structs in memory by slot, referenced for the garbage collector
 	UPROPERTY()
-	TMap<FString, UScriptStruct*> ScriptStructHooker;
+	TArray<UScriptStruct*> ScriptStructHooker;
+
+	TMap<FString, FSaveStructInfo*> StructInfos;
+
+	struct FSaveStructSlot
+	{
+		FSaveStructInfo* Info = nullptr;
+
+		// Bumped when the slot is freed, so the handles of the removed struct no longer match
+		int32 Generation = 0;
+	};
 
-	TMap<FString, TUniquePtr<FSaveStructInfo>> StructInfos;
+	// Dense slots behind FSaveStructHandle, freed slots are reused
+	TArray<FSaveStructSlot> Slots;
+	TArray<int32> FreeSlots;
 
-	class FStructLoadOrSaveTask : public FNonAbandonableTask
+	FORCEINLINE FSaveStructInfo* FindStruct(FSaveStructHandle Handle) const
 	{
-		friend class FAsyncTask<FStructLoadOrSaveTask>;
+		return Slots.IsValidIndex(Handle.Index) && Slots[Handle.Index].Generation == Handle.Generation ? Slots[Handle.Index].Info : nullptr;
+	}
 
-		TArray<uint8> DataCopy;
+	// Set by Deinitialize once the structs are destroyed, the slots are emptied too, so the handles held by FSaveStructPtr no longer resolve
+	bool bDeinitialized = false;
+
+	// Reference counting without the lookup, used by FSaveStructPtr and the handle overloads, the infos are not touched once deinitialized
+	FSaveStructInfo* AddStructRef(const FString& Filename, UScriptStruct* ScriptStruct, ESaveStructPriority Priority);
+
+	void RemoveStructRef(FSaveStructInfo* Info);
+
+	void AddLoadDelegate(FSaveStructInfo* Info, FSaveStructLoadDelegate LoadCallback);
+
+	void AddLoadDelegate(FSaveStructInfo* Info, FSaveStructLoadDynamicDelegate LoadCallback);
+
+	class FStructLoadOrSaveTask : public IQueuedWork
+	{
+		friend class UAutoSaveSubsystem;
+
+		UAutoSaveSubsystem* Owner;
 
 		FSaveStructInfo* StructInfoPtr;
 
-		FStructLoadOrSaveTask(FSaveStructInfo* InStructInfoPtr);
+		// The existence of the file is not known yet, it is created if missing
+		bool bProbe;
+
+		// Loaded without references, nothing is created for a missing file
+		bool bPrefetch;
+
+		bool bFailed;
+
+		bool bCompleted;
+
+		// Started by FlushSaveStructs instead of the scheduler
+		bool bFlush;
+
+		// Part of a FStructSaveBatch, the last task of the batch is posted last
+		bool bBatched;
+		bool bLastInBatch;
+
+		ESaveStructPriority Priority;
+
+		FDateTime RequestTime;
+
+		// When the task was created, the queue wait is measured from here
+		uint64 QueuedCycles;
+
+		// Time spent on file access by the task
+		uint64 IOCycles = 0;
+
+		// File access of the task, after compression
+		int64 BytesRead = 0;
+		int64 BytesWritten = 0;
+
+		// Estimate charged to the throttle of the class when started, INDEX_NONE when not throttled
+		int64 ChargedSize = INDEX_NONE;
+
+		// Encoded image and hash of a batched save, written by the batch
+		TArray<uint8> PendingFile;
+		uint64 PendingHash;
+		bool bPendingWrite;
+
+		// Snapshot of the struct taken when saving, the buffer comes from UAutoSaveSubsystem::SnapshotBufferPool
+		TArray<uint8> Snapshot;
+
+		FStructLoadOrSaveTask(UAutoSaveSubsystem* InOwner, FSaveStructInfo* InStructInfoPtr);
+
+		// Save a snapshot taken across frames
+		FStructLoadOrSaveTask(UAutoSaveSubsystem* InOwner, FSaveStructInfo* InStructInfoPtr, TArray<uint8>&& InSnapshot);
 
 		~FStructLoadOrSaveTask();
 
 		void DoWork();
 
+		// Run on a worker of UAutoSaveSubsystem::TaskPool, then posted to UAutoSaveSubsystem::CompletedTasks
+		virtual void DoThreadedWork() override;
+
+		virtual void Abandon() override;
+
+		void PostCompletion();
+
 		void LoadWork();
 
+		// Load from a mapping of the file, false if the file has to be read instead
+		bool LoadMappedWork();
+
+		// Keep the loaded struct as the base of the property journal
+		void InitJournalStruct();
+
 		void SaveWork();
 
-		FORCEINLINE TStatId GetStatId() const { RETURN_QUICK_DECLARE_CYCLE_STAT(FStructLoadOrSaveTask, STATGROUP_ThreadPoolAsyncTasks); }
+		// Serialize the snapshot into the file without the image in memory
+		void SaveStreamed();
+
+#if DO_GUARD_SLOW
+		// Read a streamed save back and check it equals the snapshot it was written from
+		void VerifyStreamedSave() const;
+#endif
+
+		// Serialize the snapshot, false if the file already holds the same image
+		bool SerializeSave(TArray<uint8>& OutDataBuffer);
+
+		// Take over the result of writing PendingFile as the whole file
+		void FinishWrite(bool bSuccessful);
+
+		// Serialize and encode on the way to a batched write
+		void PrepareBatchedSave();
+
+		void FinishBatchedSave();
+
+		void DestroySnapshot();
+
+		void SerializeImage(const uint8* StructData, TArray<uint8>& OutImage) const;
+
+		void SerializeImage(const uint8* StructData, FArchive& Writer) const;
+
+		bool DeserializeImage(const uint8* Image, int64 ImageSize);
+
+		bool DeserializeImage(const uint8* Image, int64 ImageSize, uint8* OutData) const;
+
+		void SaveJournaled(TArray<uint8>& DataBuffer, uint64 DataHash);
+
+		void SavePropertyJournaled();
+
+		// Rewrite the file with the image and start over with an empty journal
+		bool CompactJournal(const TArray<uint8>& DataBuffer);
+
+		bool AppendJournal(ESaveStructJournalFormat Format, const TArray<uint8>& Payload);
 
 	};
 
-	TArray<TUniquePtr<FAsyncTask<FStructLoadOrSaveTask>>> TaskThreads;
+	// Dedicated workers, null when the tasks run synchronously on the game thread
+	TUniquePtr<FQueuedThreadPool> TaskPool;
+
+	// Tasks finished by the workers, drained by the game thread
+	TQueue<FStructLoadOrSaveTask*, EQueueMode::Mpsc> CompletedTasks;
+
+	// Triggered with every completion, so the game thread can block on the tasks when flushing
+	FEvent* TaskDoneEvent = nullptr;
+
+	// Tasks added to the pool and not drained yet
+	int32 InFlightTaskNum = 0;
+
+	// Tasks of FlushSaveStructs not drained yet, they are retracted from the pool when the deadline is reached
+	TSet<FStructLoadOrSaveTask*> FlushTasks;
+
+	void StartTask(FSaveStructInfo* Info, bool bFlush = false);
+
+	// Saves serialized in parallel and written in one pass, a single work item of the pool
+	class FStructSaveBatch : public IQueuedWork
+	{
+		friend class UAutoSaveSubsystem;
+
+		UAutoSaveSubsystem* Owner;
+
+		TArray<FStructLoadOrSaveTask*> Tasks;
+
+		// Committed all or nothing when not NAME_None
+		FName Group;
+
+		FStructSaveBatch(UAutoSaveSubsystem* InOwner, FName InGroup) : Owner(InOwner), Group(InGroup) { }
+
+		void Run();
+
+		void Commit();
+
+		// Stage the files next to their targets, then move them in place under a commit manifest
+		bool CommitGroup(const TArray<FStructLoadOrSaveTask*>& Writes);
+
+		virtual void DoThreadedWork() override;
+
+		virtual void Abandon() override;
+
+	};
+
+	// Tasks inside the batches in flight, and the batches themselves, a batch occupies a single slot of the pool
+	int32 BatchedTaskNum = 0;
+	int32 InFlightBatchNum = 0;
+
+	FORCEINLINE int32 GetInFlightWorkNum() const { return InFlightTaskNum - BatchedTaskNum + InFlightBatchNum; }
+
+	TMultiMap<FName, FSaveStructInfo*> SaveGroups;
+
+	FORCEINLINE bool ShouldBatchSave(const FSaveStructInfo* Info) const { return Info->SaveGroup != NAME_None || (SaveBatchSize > 1 && (!bJournaledStorage || Pack)); }
+
+	FORCEINLINE bool CanJoinSaveBatch(const FSaveStructInfo* Info) const { return Info->SaveGroup == NAME_None && !ShouldSnapshotIncrementally(Info); }
+
+	// Add the other members of the group, or further released and due saves of the same partition up to SaveBatchSize, its in flight limit and the save budget.
+	// The members are charged to the budget as they join, the batch is started without charging them again.
+	void CollectSaveBatch(TArray<FSaveStructInfo*>& InOutInfos);
+
+	void StartSaveBatch(const TArray<FSaveStructInfo*>& Infos, bool bFlush = false);
+
+	// Without the pool the batch runs on the game thread
+	void RunSaveBatch(const TArray<FSaveStructInfo*>& Infos, bool bFlush = false);
+
+	struct FPendingSnapshot
+	{
+		FSaveStructInfo* Info;
+
+		TSharedPtr<class FSaveStructSnapshot> Snapshot;
+	};
+
+	// Snapshots taken across frames, the oldest is advanced first, each of them counts as a task in flight
+	TArray<FPendingSnapshot> Snapshots;
+
+	// Structs with native serializers may depend on members the properties do not cover
+	FORCEINLINE bool ShouldSnapshotIncrementally(const FSaveStructInfo* Info) const
+	{
+		return IncrementalSnapshotSize > 0 && bExplicitDirtyTracking && Info->ImageSize >= IncrementalSnapshotSize && !(Info->Struct->StructFlags & STRUCT_SerializeNative);
+	}
+
+	void BeginSnapshot(FSaveStructInfo* Info);
+
+	void HandleSnapshots();
+
+	// Advance a snapshot under the read lock, a write scope taken between the steps starts the copy over and finishes it at once
+	bool StepSnapshot(FPendingSnapshot& PendingSnapshot, double EndTime);
+
+	// Complete the snapshot at once and start its task
+	void FinishSnapshot(FSaveStructInfo* Info);
+
+	void StartSnapshotTask(int32 SnapshotIndex);
+
+	// Drop the unfinished snapshots of the partition, or all of them with INDEX_NONE, the structs are dirty again
+	void AbortSnapshots(int32 PartitionIndex = INDEX_NONE);
+
+	// A snapshot in progress is finished first, so the modification is not part of it
+	void MarkStructDirty(FSaveStructInfo* Info);
+
+	// Wait for the tasks of the partition, or all of them with INDEX_NONE
+	void WaitForTasks(int32 PartitionIndex = INDEX_NONE);
+
+	TSharedPtr<class FSaveStructPack> Pack;
+
+	// Storage of the struct infos and their payloads, created by Initialize
+	TSharedPtr<class FSaveStructInfoPool> InfoPool;
+	TSharedPtr<class FSaveStructPayloadAllocator> PayloadAllocator;
+
+	// Reused snapshot buffers, so saving does not reallocate the whole struct every time, two per thread at most
+	TArray<TArray<uint8>> SnapshotBufferPool;
+
+	// Pool the emptied buffer, or free it when the pool is full or the buffer is too large to keep
+	void ReleaseSnapshotBuffer(TArray<uint8>&& Buffer);
+
+	FAutoSaveCounters Counters;
+
+	struct FStructDueEntry
+	{
+		FDateTime LastSaveTime;
+
+		FSaveStructHandle Handle;
+
+		// All Idle structs share the same SaveWaitTime, so the order of LastSaveTime is also the order of the due time
+		FORCEINLINE bool operator<(const FStructDueEntry& Other) const { return LastSaveTime < Other.LastSaveTime; }
+	};
+
+	struct FStructPrefetchEntry
+	{
+		int32 Priority;
+
+		uint64 Sequence;
+
+		FSaveStructHandle Handle;
+
+		// Higher priority first, then first come first served
+		FORCEINLINE bool operator<(const FStructPrefetchEntry& Other) const { return Priority != Other.Priority ? Priority > Other.Priority : Sequence < Other.Sequence; }
+	};
+
+	uint64 PrefetchSequence = 0;
+
+	// Scheduling state of the structs under a root directory, the structs outside of every root are in the default partition at index 0
+	struct FSaveStructPartition
+	{
+		FName Name;
+
+		FString RootDirectory;
+
+		// Zero for no limit
+		int32 MaxInFlightTaskNum = 0;
+
+		int32 InFlightTaskNum = 0;
+
+		// Structs in memory, FSaveStructInfo::PartitionMemberIndex is the index in here
+		TArray<FSaveStructInfo*> Members;
+
+		// Pending and Preload structs with references by class, in FIFO order, entries are validated when popped
+		TQueue<FSaveStructHandle> CriticalLoadQueue;
+		TQueue<FSaveStructHandle> LoadQueue;
+
+		// Released Idle or Failed structs, in FIFO order, entries are validated when popped
+		TQueue<FSaveStructHandle> ReleaseQueue;
+
+		// Entries in the three queues above, and in the release queue alone
+		int32 QueuedEntryNum = 0;
+		int32 ReleaseEntryNum = 0;
+
+		// Prefetched structs, handled after the loads and the released structs
+		TArray<FStructPrefetchEntry> PrefetchHeap;
+
+		// Min-heap of the Idle structs with references, entries are validated when popped
+		TArray<FStructDueEntry> DueHeap;
+
+		// Dirty structs taken off the heap once due by MaintainPartition, in the order they became due
+		TQueue<FStructDueEntry> DueQueue;
+		int32 DueQueueNum = 0;
+
+		FORCEINLINE bool HasInFlightQuota() const { return MaxInFlightTaskNum <= 0 || InFlightTaskNum < MaxInFlightTaskNum; }
+	};
+
+	// Never empty between Initialize and Deinitialize, partitions are only removed by UnloadSaveStructPartition
+	TArray<TUniquePtr<FSaveStructPartition>> Partitions;
+
+	// Index of the partitions by root directory
+	TMap<FString, int32> PartitionRoots;
+
+	// The partition the task start goes round from, advanced every tick so no partition is always served first
+	int32 PartitionCursor = 0;
+
+	FORCEINLINE FSaveStructPartition& GetPartition(const FSaveStructInfo* Info) const
+	{
+		check(Partitions.IsValidIndex(Info->PartitionIndex));
+		return *Partitions[Info->PartitionIndex];
+	}
+
+	int32 FindPartition(FName Partition) const;
+
+	// The partition of the innermost root directory the file is under
+	int32 FindFilePartition(const FString& Filename) const;
+
+	// Save the loaded structs of the partition, or of all partitions with INDEX_NONE
+	TArray<FString> FlushStructs(int32 PartitionIndex, FTimespan Deadline);
+
+	// Drop the stale entries and move the due structs to the due queue, the clean ones are treated as saved.
+	// Only touches the partition and its members, so the partitions are maintained in parallel.
+	void MaintainPartition(FSaveStructPartition& Partition, const FDateTime& NowTime);
+
+	void MaintainPartitions(const FDateTime& NowTime);
+
+	TMap<UScriptStruct*, TSharedPtr<class FSaveStructPlan>> SerializationPlans;
+
+	// Prefetched structs are created without references
+	FSaveStructInfo* CreateStructInfo(const FString& Filename, UScriptStruct* ScriptStruct, ESaveStructPriority Priority, int32 PrefetchPriority = 0);
+
+	void ScheduleStruct(FSaveStructInfo* Info);
+
+	FORCEINLINE bool IsCleanStruct(const FSaveStructInfo* Info) const { return bExplicitDirtyTracking && !Info->bDirty && Info->WriteSerial.GetValue() == Info->SnapshotWriteSerial; }
+
+	// Pick the next struct of the partition in the order of the classes, only critical and normal loads when bDemandLoadsOnly.
+	// Saves are skipped when bSkipSaves and normal and prefetch loads when bSkipLoads, so each budget only holds back its own classes.
+	FSaveStructInfo* FindPreHandleStruct(FSaveStructPartition& Partition, const FDateTime& NowTime, bool bDemandLoadsOnly = false, bool bSkipSaves = false, bool bSkipLoads = false);
+
+	// The released and the due saves of the partition, when bBatchableOnly a struct that cannot join a batch ends the search and stays at the front of its queue
+	FSaveStructInfo* FindReleasedStruct(FSaveStructPartition& Partition, bool bBatchableOnly = false);
+	FSaveStructInfo* FindDueStruct(FSaveStructPartition& Partition, bool bBatchableOnly = false);
+
+	// Start the task, snapshot or batch of the picked struct
+	void StartPreHandleStruct(FSaveStructInfo* Info);
+
+	void RecordTaskLatency(const FStructLoadOrSaveTask& Task, const FDateTime& NowTime);
+
+	// Released structs, the most recently released first
+	TDoubleLinkedList<FSaveStructInfo*> ResidentList;
+
+	int64 ResidentSize = 0;
+
+	// Keep the struct resident if the budget allows, otherwise remove it
+	void ReleaseStruct(FSaveStructInfo* Info);
+
+	void EvictResidentStruct();
+
+	// Remove the struct from memory and free its slot
+	void RemoveStructInfo(FSaveStructInfo* Info);
+
+	void DestroyStructInfo(FSaveStructInfo* Info);
 
 	void HandleTaskStart();
 
 	void HandleTaskDone();
 
-	TMap<FString, FSaveStructLoadDelegates> LoadDelegates;
-	TMap<FString, FSaveStructLoadDynamicDelegates> LoadDynamicDelegates;
+	// Structs with load delegates bound, stale handles are dropped
+	TArray<FSaveStructHandle> LoadDelegateStructs;
 
 	void HandleLoadDelegates();
 
+	// Null when the budget of the class is unlimited
+	TSharedPtr<class FAutoSaveThrottle> SaveThrottle;
+	TSharedPtr<class FAutoSaveThrottle> LoadThrottle;
+
+	// Null for the classes that are not throttled
+	class FAutoSaveThrottle* GetThrottle(ESaveStructPriority Priority) const;
+
+	// Whether the budget holds back the next task of its classes
+	bool IsSaveThrottled() const;
+	bool IsLoadThrottled() const;
+
+	// Charge the size of the last image of a struct about to be handled, as the estimate of its task
+	void ChargeThrottle(const FSaveStructInfo* Info);
+
+	// Charge the estimated size of a task started by the scheduler, the members of a batch are charged by CollectSaveBatch
+	void ThrottleTask(FStructLoadOrSaveTask& Task, bool bCharged = false);
+
+	// Charge the difference between the actual and the estimated size once the task is done
+	void SettleThrottle(const FStructLoadOrSaveTask& Task);
+
+	bool bSaveBackpressure = false;
+
+	void UpdateBackpressure();
+
 private:
 
 	//~ Begin USubsystem Interface
@@ -123,8 +942,8 @@ private:
 
 	//~ Begin FTickableGameObject Interface
 	virtual void Tick(float DeltaTime) override;
-	virtual bool IsTickable() const override { return !IsTemplate(); }
-	virtual TStatId GetStatId() const override { return GetStatID(); }
+	virtual bool IsTickable() const override { return !IsTemplate() && !bDeinitialized; }
+	virtual TStatId GetStatId() const override;
 	//~ End FTickableGameObject Interface
 
 };
@@ -14,10 +14,29 @@ class AUTOSAVE_API UAutoSaveBlueprintLibrary : public UBlueprintFunctionLibrary
 public:
 
 	UFUNCTION(BlueprintCallable, Category = "AutoSave", meta = (WorldContext = "WorldContextObject"))
-	static bool AddSaveStructRef(UObject* WorldContextObject, const FString& Filename, UScriptStruct* ScriptStruct, FSaveStructLoadDynamicDelegate LoadCallback);
+	static bool AddSaveStructRef(UObject* WorldContextObject, const FString& Filename, UScriptStruct* ScriptStruct, FSaveStructLoadDynamicDelegate LoadCallback, ESaveStructPriority Priority = ESaveStructPriority::NormalLoad);
 
 	UFUNCTION(BlueprintCallable, Category = "AutoSave", meta = (WorldContext = "WorldContextObject"))
 	static void RemoveSaveStructRef(UObject* WorldContextObject, const FString& Filename);
+
+	UFUNCTION(BlueprintCallable, Category = "AutoSave", meta = (WorldContext = "WorldContextObject"))
+	static int32 PrefetchSaveStructs(UObject* WorldContextObject, const TArray<FSaveStructPrefetchRequest>& Requests, int32 Priority = 0);
+
+	UFUNCTION(BlueprintCallable, Category = "AutoSave", meta = (WorldContext = "WorldContextObject"))
+	static void MarkSaveStructDirty(UObject* WorldContextObject, const FString& Filename);
+
+	// Add a reference like AddSaveStructRef and return the handle of the struct, the handle functions skip the filename lookup
+	UFUNCTION(BlueprintCallable, Category = "AutoSave", meta = (WorldContext = "WorldContextObject"))
+	static FSaveStructHandle AcquireSaveStruct(UObject* WorldContextObject, const FString& Filename, UScriptStruct* ScriptStruct, FSaveStructLoadDynamicDelegate LoadCallback, bool& bSuccess, ESaveStructPriority Priority = ESaveStructPriority::NormalLoad);
+
+	UFUNCTION(BlueprintCallable, Category = "AutoSave", meta = (WorldContext = "WorldContextObject"))
+	static void ReleaseSaveStruct(UObject* WorldContextObject, FSaveStructHandle Handle);
+
+	UFUNCTION(BlueprintPure, Category = "AutoSave", meta = (WorldContext = "WorldContextObject"))
+	static bool IsSaveStructHandleLoaded(UObject* WorldContextObject, FSaveStructHandle Handle);
+
+	UFUNCTION(BlueprintCallable, Category = "AutoSave", meta = (WorldContext = "WorldContextObject"))
+	static void MarkSaveStructDirtyByHandle(UObject* WorldContextObject, FSaveStructHandle Handle);
 	
 	UFUNCTION(BlueprintCallable, Category = "AutoSave", meta = (WorldContext = "WorldContextObject", CustomStructureParam = "Value"), CustomThunk)
 	static void TryGetSaveStruct(UObject* WorldContextObject, const FString& Filename, int32& Value, bool& bSuccess) { checkNoEntry(); }
@@ -60,4 +79,54 @@ public:
 		bSuccess = Generic_TrySetSaveStruct(WorldContextObject, Filename, StructProperty ? StructProperty->Struct : nullptr, StructPtr);
 		P_NATIVE_END;
 	}
+
+	UFUNCTION(BlueprintCallable, Category = "AutoSave", meta = (WorldContext = "WorldContextObject", CustomStructureParam = "Value"), CustomThunk)
+	static void TryGetSaveStructByHandle(UObject* WorldContextObject, FSaveStructHandle Handle, int32& Value, bool& bSuccess) { checkNoEntry(); }
+	static bool Generic_TryGetSaveStructByHandle(UObject* WorldContextObject, FSaveStructHandle Handle, UScriptStruct* ScriptStruct, void* Value);
+	DECLARE_FUNCTION(execTryGetSaveStructByHandle)
+	{
+		P_GET_OBJECT(UObject, WorldContextObject);
+		P_GET_STRUCT(FSaveStructHandle, Handle);
+
+		Stack.Step(Stack.Object, nullptr);
+		void* StructPtr = Stack.MostRecentPropertyAddress;
+		FStructProperty* StructProperty = CastField<FStructProperty>(Stack.MostRecentProperty);
+
+		P_GET_UBOOL_REF(bSuccess);
+
+		P_FINISH;
+
+		P_NATIVE_BEGIN;
+		bSuccess = Generic_TryGetSaveStructByHandle(WorldContextObject, Handle, StructProperty ? StructProperty->Struct : nullptr, StructPtr);
+		P_NATIVE_END;
+	}
+
+	UFUNCTION(BlueprintCallable, Category = "AutoSave", meta = (WorldContext = "WorldContextObject", CustomStructureParam = "Value"), CustomThunk)
+	static void TrySetSaveStructByHandle(UObject* WorldContextObject, FSaveStructHandle Handle, const int32& Value, bool& bSuccess) { checkNoEntry(); }
+	static bool Generic_TrySetSaveStructByHandle(UObject* WorldContextObject, FSaveStructHandle Handle, UScriptStruct* ScriptStruct, void* Value);
+	DECLARE_FUNCTION(execTrySetSaveStructByHandle)
+	{
+		P_GET_OBJECT(UObject, WorldContextObject);
+		P_GET_STRUCT(FSaveStructHandle, Handle);
+
+		Stack.Step(Stack.Object, nullptr);
+		void* StructPtr = Stack.MostRecentPropertyAddress;
+		FStructProperty* StructProperty = CastField<FStructProperty>(Stack.MostRecentProperty);
+
+		P_GET_UBOOL_REF(bSuccess);
+
+		P_FINISH;
+
+		P_NATIVE_BEGIN;
+		bSuccess = Generic_TrySetSaveStructByHandle(WorldContextObject, Handle, StructProperty ? StructProperty->Struct : nullptr, StructPtr);
+		P_NATIVE_END;
+	}
+
+private:
+
+	static UAutoSaveSubsystem* GetAutoSaveSubsystem(UObject* WorldContextObject);
+
+	static bool CopyFromSaveStruct(FSaveStructInfo* Info, UScriptStruct* ScriptStruct, void* Value);
+
+	static bool CopyToSaveStruct(UAutoSaveSubsystem* AutoSaveSubsystem, FSaveStructInfo* Info, UScriptStruct* ScriptStruct, void* Value);
 };
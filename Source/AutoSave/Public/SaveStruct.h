@@ -8,74 +8,103 @@ struct FSaveStructInfo;
 
 class UAutoSaveSubsystem;
 
+template<typename SaveStructType> class FSaveStructReadScope;
+template<typename SaveStructType> class FSaveStructWriteScope;
+
 template<typename SaveStructType>
 class FSaveStructPtr : public FNoncopyable
 {
+	friend class FSaveStructReadScope<SaveStructType>;
+	friend class FSaveStructWriteScope<SaveStructType>;
+
 public:
 
 	FORCEINLINE FSaveStructPtr()
 		: AutoSaveSubsystem(nullptr)
-		, Info(nullptr)
 	{
 	}
 
-	FORCEINLINE FSaveStructPtr(UAutoSaveSubsystem* InAutoSaveSubsystem, const FString& Filename)
+	FORCEINLINE FSaveStructPtr(UAutoSaveSubsystem* InAutoSaveSubsystem, const FString& Filename, ESaveStructPriority Priority = ESaveStructPriority::NormalLoad)
 		: AutoSaveSubsystem(InAutoSaveSubsystem)
-		, Info(nullptr)
+		, Handle(AddRef(Filename, Priority))
 	{
-		if (AutoSaveSubsystem->AddSaveStructRef(Filename, SaveStructType::StaticStruct()))
-		{
-			Info = AutoSaveSubsystem->StructInfos[Filename].Get();
-		}
 	}
 
-	FORCEINLINE FSaveStructPtr(UAutoSaveSubsystem* InAutoSaveSubsystem, const FString& Filename, FSaveStructLoadDelegate OnLoaded)
+	FORCEINLINE FSaveStructPtr(UAutoSaveSubsystem* InAutoSaveSubsystem, const FString& Filename, FSaveStructLoadDelegate OnLoaded, ESaveStructPriority Priority = ESaveStructPriority::NormalLoad)
 		: AutoSaveSubsystem(InAutoSaveSubsystem)
-		, Info(nullptr)
+		, Handle(AddRef(Filename, Priority))
 	{
-		if (AutoSaveSubsystem->AddSaveStructRef(Filename, SaveStructType::StaticStruct(), OnLoaded))
+		if (FSaveStructInfo* Info = GetInfo())
 		{
-			Info = AutoSaveSubsystem->StructInfos[Filename].Get();
+			AutoSaveSubsystem->AddLoadDelegate(Info, OnLoaded);
 		}
 	}
 
-	FORCEINLINE FSaveStructPtr(UAutoSaveSubsystem* InAutoSaveSubsystem, const FString& Filename, FSaveStructLoadDynamicDelegate OnLoaded)
+	FORCEINLINE FSaveStructPtr(UAutoSaveSubsystem* InAutoSaveSubsystem, const FString& Filename, FSaveStructLoadDynamicDelegate OnLoaded, ESaveStructPriority Priority = ESaveStructPriority::NormalLoad)
 		: AutoSaveSubsystem(InAutoSaveSubsystem)
-		, Info(nullptr)
+		, Handle(AddRef(Filename, Priority))
 	{
-		if (AutoSaveSubsystem->AddSaveStructRef(Filename, SaveStructType::StaticStruct(), OnLoaded))
+		if (FSaveStructInfo* Info = GetInfo())
 		{
-			Info = AutoSaveSubsystem->StructInfos[Filename].Get();
+			AutoSaveSubsystem->AddLoadDelegate(Info, OnLoaded);
 		}
 	}
 
 	FORCEINLINE ~FSaveStructPtr()
 	{
-		if (Info)
+		if (FSaveStructInfo* Info = GetInfo())
 		{
-			AutoSaveSubsystem->RemoveSaveStructRef(Info->Filename);
+			AutoSaveSubsystem->RemoveStructRef(Info);
 		}
 	}
 
+	// Stays valid while the pointer holds its reference, and can be handed to Blueprint
+	FORCEINLINE FSaveStructHandle GetHandle() const
+	{
+		return Handle;
+	}
+
 	FORCEINLINE SaveStructType* Get() const
 	{
-		return Info ? (SaveStructType*)Info->Data.GetData() : nullptr;
+		FSaveStructInfo* Info = GetInfo();
+		return Info ? (SaveStructType*)Info->Data : nullptr;
+	}
+
+	FORCEINLINE SaveStructType* GetMutable() const
+	{
+		MarkDirty();
+		return Get();
+	}
+
+	FORCEINLINE void MarkDirty() const
+	{
+		if (FSaveStructInfo* Info = GetInfo())
+		{
+			AutoSaveSubsystem->MarkStructDirty(Info);
+		}
 	}
 
 	FORCEINLINE explicit operator bool() const
 	{
-		return Info != nullptr;
+		return IsValid();
 	}
 
+	// False once the subsystem is deinitialized, the struct is gone with it
 	FORCEINLINE const bool IsValid() const
 	{
-		return Info != nullptr;
+		return GetInfo() != nullptr;
 	}
 
 	FORCEINLINE const bool IsLoaded() const
 	{
-		check(IsValid());
-		return Info->State == ESaveStructState::Idle || Info->State == ESaveStructState::Saving;
+		const FSaveStructInfo* Info = GetInfo();
+		return Info && Info->IsLoaded();
+	}
+
+	FORCEINLINE const bool IsFailed() const
+	{
+		const FSaveStructInfo* Info = GetInfo();
+		return Info && Info->State == ESaveStructState::Failed;
 	}
 
 	FORCEINLINE SaveStructType& operator*() const
@@ -94,6 +123,99 @@ private:
 
 	UAutoSaveSubsystem* AutoSaveSubsystem;
 
+	// Resolved on each access, so the struct is not reached once the subsystem destroyed it
+	FSaveStructHandle Handle;
+
+	FORCEINLINE FSaveStructHandle AddRef(const FString& Filename, ESaveStructPriority Priority) const
+	{
+		FSaveStructInfo* Info = AutoSaveSubsystem->AddStructRef(Filename, SaveStructType::StaticStruct(), Priority);
+		return Info ? Info->Handle : FSaveStructHandle();
+	}
+
+	FORCEINLINE FSaveStructInfo* GetInfo() const
+	{
+		return AutoSaveSubsystem ? AutoSaveSubsystem->FindStruct(Handle) : nullptr;
+	}
+
+};
+
+// Shared access to a struct from any thread, the pointer must outlive the scope.
+// Once worker threads access a struct the game thread goes through the scopes as well, and calls nothing on the subsystem while holding one.
+// The load holds the lock while it fills the struct, a scope taken before the struct is loaded sees the default struct or waits for the load.
+template<typename SaveStructType>
+class FSaveStructReadScope : public FNoncopyable
+{
+public:
+
+	FORCEINLINE explicit FSaveStructReadScope(const FSaveStructPtr<SaveStructType>& Ptr)
+		: Info(Ptr.GetInfo())
+	{
+		check(Info);
+		Info->DataLock.ReadLock();
+	}
+
+	FORCEINLINE ~FSaveStructReadScope()
+	{
+		Info->DataLock.ReadUnlock();
+	}
+
+	FORCEINLINE const SaveStructType* Get() const
+	{
+		return (const SaveStructType*)Info->Data;
+	}
+
+	FORCEINLINE const SaveStructType& operator*() const
+	{
+		return *Get();
+	}
+
+	FORCEINLINE const SaveStructType* operator->() const
+	{
+		return Get();
+	}
+
+private:
+
+	FSaveStructInfo* Info;
+
+};
+
+// Exclusive access to a loaded struct from any thread, the struct counts as modified, see FSaveStructReadScope
+template<typename SaveStructType>
+class FSaveStructWriteScope : public FNoncopyable
+{
+public:
+
+	FORCEINLINE explicit FSaveStructWriteScope(const FSaveStructPtr<SaveStructType>& Ptr)
+		: Info(Ptr.GetInfo())
+	{
+		check(Info);
+		Info->DataLock.WriteLock();
+		Info->WriteSerial.Increment();
+	}
+
+	FORCEINLINE ~FSaveStructWriteScope()
+	{
+		Info->DataLock.WriteUnlock();
+	}
+
+	FORCEINLINE SaveStructType* Get() const
+	{
+		return (SaveStructType*)Info->Data;
+	}
+
+	FORCEINLINE SaveStructType& operator*() const
+	{
+		return *Get();
+	}
+
+	FORCEINLINE SaveStructType* operator->() const
+	{
+		return Get();
+	}
+
+private:
+
 	FSaveStructInfo* Info;
 
 };
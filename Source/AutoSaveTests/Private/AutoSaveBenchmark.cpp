@@ -0,0 +1,494 @@
+#include "AutoSaveBenchmark.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "AutoSaveLog.h"
+#include "Dom/JsonObject.h"
+#include "Engine/GameInstance.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformProperties.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "Subsystems/SubsystemCollection.h"
+#include "Tickable.h"
+
+namespace
+{
+	const int32 BenchmarkCounts[] = { 1, 100, 10000, 100000 };
+
+	const int64 BenchmarkSizes[] = { 100, 10 * 1024, 1024 * 1024, 100 * 1024 * 1024 };
+
+	const int32 BenchmarkThreadNums[] = { 0, 1, 4, 8 };
+
+	// A phase waiting longer than this is reported as an error instead of blocking the automation run
+	const double MaxPhaseSeconds = 600.0;
+
+	FString GetBenchmarkDir()
+	{
+		return FPaths::ConvertRelativePathToFull(FPaths::ProjectSavedDir() / TEXT("AutoSave") / TEXT("Benchmark"));
+	}
+
+	TSharedRef<FJsonObject> DescribeTickTimes(const TArray<double>& TickTimes)
+	{
+		TArray<double> Sorted = TickTimes;
+		Sorted.Sort();
+
+		double Total = 0.0;
+		for (double Time : Sorted) Total += Time;
+
+		TSharedRef<FJsonObject> Result = MakeShared<FJsonObject>();
+		Result->SetNumberField(TEXT("Num"), Sorted.Num());
+		Result->SetNumberField(TEXT("TotalMs"), Total * 1000.0);
+		Result->SetNumberField(TEXT("MeanMs"), Sorted.Num() ? Total * 1000.0 / Sorted.Num() : 0.0);
+		Result->SetNumberField(TEXT("P50Ms"), Sorted.Num() ? Sorted[Sorted.Num() / 2] * 1000.0 : 0.0);
+		Result->SetNumberField(TEXT("P99Ms"), Sorted.Num() ? Sorted[Sorted.Num() * 99 / 100] * 1000.0 : 0.0);
+		Result->SetNumberField(TEXT("MaxMs"), Sorted.Num() ? Sorted.Last() * 1000.0 : 0.0);
+		return Result;
+	}
+
+	TSharedRef<FJsonObject> DescribeHistogram(const FAutoSaveLatencyHistogram& Histogram)
+	{
+		TSharedRef<FJsonObject> Result = MakeShared<FJsonObject>();
+		Result->SetNumberField(TEXT("Num"), Histogram.GetNum());
+		Result->SetNumberField(TEXT("P50Ms"), Histogram.GetPercentile(0.5f) * 1000.0);
+		Result->SetNumberField(TEXT("P99Ms"), Histogram.GetPercentile(0.99f) * 1000.0);
+		return Result;
+	}
+}
+
+// Sweeps the struct count, the struct size and the thread count, run with the command Automation RunTests AutoSave.Benchmark.
+// The cases hold their structs in memory, those beyond AutoSaveBenchmarkMaxBytes= in total on the command line are left out, 1 GiB by default.
+// Each case starts a subsystem of its own, which completes the group commits left in the saved directory, so no game should be saving meanwhile.
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FAutoSaveBenchmarkTest, "AutoSave.Benchmark", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::PerfFilter)
+
+void FAutoSaveBenchmarkTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	int64 MaxBytes = 1024LL * 1024 * 1024;
+	FParse::Value(FCommandLine::Get(), TEXT("AutoSaveBenchmarkMaxBytes="), MaxBytes);
+
+	for (const bool bNumeric : { false, true })
+	{
+		for (const int32 Count : BenchmarkCounts)
+		{
+			for (const int64 Size : BenchmarkSizes)
+			{
+				if (Count * Size > MaxBytes) continue;
+
+				for (const int32 ThreadNum : BenchmarkThreadNums)
+				{
+					OutBeautifiedNames.Add(FString::Printf(TEXT("%s.%d Structs.%lld Bytes.%d Threads"), bNumeric ? TEXT("Numeric") : TEXT("Payload"), Count, Size, ThreadNum));
+					OutTestCommands.Add(FString::Printf(TEXT("Count=%d Size=%lld Threads=%d Numeric=%d"), Count, Size, ThreadNum, bNumeric ? 1 : 0));
+				}
+			}
+		}
+	}
+}
+
+bool FAutoSaveBenchmarkTest::RunTest(const FString& Parameters)
+{
+	FAutoSaveBenchmark Benchmark(*this, Parameters);
+
+	return Benchmark.Run();
+}
+
+FAutoSaveBenchmark::FAutoSaveBenchmark(FAutomationTestBase& InTest, const FString& Parameters)
+	: Test(InTest)
+{
+	FParse::Value(*Parameters, TEXT("Count="), Count);
+	FParse::Value(*Parameters, TEXT("Size="), Size);
+	FParse::Value(*Parameters, TEXT("Threads="), ThreadNum);
+	FParse::Bool(*Parameters, TEXT("Numeric="), bNumeric);
+
+	FParse::Value(FCommandLine::Get(), TEXT("AutoSaveBenchmarkChurn="), ChurnNum);
+	FParse::Value(FCommandLine::Get(), TEXT("AutoSaveBenchmarkChurnRatio="), ChurnRatio);
+	FParse::Value(FCommandLine::Get(), TEXT("AutoSaveBenchmarkFrameTime="), FrameTime);
+
+	Count = FMath::Max(Count, 1);
+	Size = FMath::Max<int64>(Size, 0);
+	ThreadNum = FMath::Max(ThreadNum, 0);
+
+	// A new directory for every case, so no file of an earlier run is loaded
+	Directory = GetBenchmarkDir() / FGuid::NewGuid().ToString();
+
+	for (int32 Index = 0; Index < Count; ++Index)
+	{
+		Filenames.Add(Directory / FString::Printf(TEXT("%d.sav"), Index));
+	}
+
+	GameInstance = NewObject<UGameInstance>(GetTransientPackage());
+	GameInstance->AddToRoot();
+
+	// The subsystem starts from the project settings, without anything kept from the subsystem of the game
+	Subsystem = NewObject<UAutoSaveSubsystem>(GameInstance);
+	Subsystem->AddToRoot();
+
+	Subsystem->MaxThreadNum = ThreadNum;
+	Subsystem->bPackedStorage = false;
+	Subsystem->ResidentCacheBudget = 0;
+	Subsystem->SaveWaitTime = FTimespan(ETimespan::MaxTicks);
+	Subsystem->ShutdownFlushDeadline = FTimespan::Zero();
+
+	FSubsystemCollection<UGameInstanceSubsystem> Collection;
+	static_cast<USubsystem*>(Subsystem)->Initialize(Collection);
+}
+
+FAutoSaveBenchmark::~FAutoSaveBenchmark()
+{
+	static_cast<USubsystem*>(Subsystem)->Deinitialize();
+
+	Subsystem->RemoveFromRoot();
+	GameInstance->RemoveFromRoot();
+
+	IFileManager::Get().DeleteDirectory(*Directory, false, true);
+}
+
+UScriptStruct* FAutoSaveBenchmark::GetStruct() const
+{
+	return bNumeric ? FAutoSaveBenchmarkNumericStruct::StaticStruct() : FAutoSaveBenchmarkStruct::StaticStruct();
+}
+
+void FAutoSaveBenchmark::Acquire(const FString& Filename)
+{
+	Subsystem->AddSaveStructRef(Filename, GetStruct(), FSaveStructLoadDelegate::CreateLambda([this](const FString&) { ++LoadedNum; }));
+}
+
+void FAutoSaveBenchmark::AcquireAll()
+{
+	for (const FString& Filename : Filenames)
+	{
+		Acquire(Filename);
+	}
+}
+
+void FAutoSaveBenchmark::ReleaseAll()
+{
+	for (const FString& Filename : Filenames)
+	{
+		Subsystem->RemoveSaveStructRef(Filename);
+	}
+}
+
+void FAutoSaveBenchmark::FillAll()
+{
+	for (int32 Index = 0; Index < Filenames.Num(); ++Index)
+	{
+		const FSaveStructHandle Handle = Subsystem->GetSaveStructHandle(Filenames[Index]);
+
+		if (!Subsystem->IsSaveStructLoaded(Handle)) continue;
+
+		Subsystem->MarkSaveStructDirty(Handle);
+
+		FRandomStream Random(Index);
+
+		if (bNumeric)
+		{
+			FAutoSaveBenchmarkNumericStruct* Struct = (FAutoSaveBenchmarkNumericStruct*)Subsystem->GetSaveStruct(Handle);
+
+			Struct->Index = Index;
+			Struct->Origin = Random.GetUnitVector();
+			Struct->Points.SetNumUninitialized(Size / 2 / sizeof(FVector));
+			Struct->Counters.SetNumUninitialized(Size / 2 / sizeof(int32));
+
+			for (FVector& Point : Struct->Points) Point = Random.VRand() * Random.FRandRange(0.0f, 100000.0f);
+			for (int32& Counter : Struct->Counters) Counter = Random.RandRange(0, 1000);
+		}
+		else
+		{
+			FAutoSaveBenchmarkStruct* Struct = (FAutoSaveBenchmarkStruct*)Subsystem->GetSaveStruct(Handle);
+
+			Struct->Index = Index;
+			Struct->Name = FString::Printf(TEXT("Benchmark %d"), Index);
+			Struct->Payload.SetNumUninitialized(Size);
+
+			for (float& Value : Struct->Values) Value = Random.FRand();
+
+			// Half random and half repeated bytes, so compression has something to do without making it trivial
+			for (int64 Offset = 0; Offset < Size; ++Offset)
+			{
+				Struct->Payload[Offset] = (Offset & 1) ? (uint8)Random.GetUnsignedInt() : (uint8)Index;
+			}
+		}
+	}
+}
+
+bool FAutoSaveBenchmark::IsReleased() const
+{
+	// Without the resident cache a released struct leaves the memory once saved
+	return Filenames.FindByPredicate([this](const FString& Filename) { return Subsystem->GetSaveStructHandle(Filename).IsValid(); }) == nullptr;
+}
+
+int64 FAutoSaveBenchmark::GetFileSize() const
+{
+	int64 Result = 0;
+
+	for (const FString& Filename : Filenames)
+	{
+		Result += FMath::Max<int64>(IFileManager::Get().FileSize(*Filename), 0);
+	}
+
+	return Result;
+}
+
+void FAutoSaveBenchmark::TickOnce(TArray<double>& TickTimes)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	static_cast<FTickableGameObject*>(Subsystem)->Tick(FrameTime);
+
+	const double TickTime = FPlatformTime::Seconds() - StartTime;
+
+	TickTimes.Add(TickTime);
+
+	// The rest of the frame is left to the worker threads
+	if (FrameTime > TickTime)
+	{
+		FPlatformProcess::Sleep(FrameTime - TickTime);
+	}
+	else
+	{
+		FPlatformProcess::Sleep(0.0f);
+	}
+}
+
+bool FAutoSaveBenchmark::TickUntil(TFunctionRef<bool()> Condition, TArray<double>& TickTimes)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	while (!Condition())
+	{
+		if (FPlatformTime::Seconds() - StartTime > MaxPhaseSeconds)
+		{
+			Test.AddError(FString::Printf(TEXT("The benchmark phase did not finish within %.0f seconds."), MaxPhaseSeconds));
+			return false;
+		}
+
+		TickOnce(TickTimes);
+	}
+
+	return true;
+}
+
+void FAutoSaveBenchmark::AddPhase(const FString& Name, double Seconds, int32 JobNum, int64 ByteNum, const TArray<double>& TickTimes, uint64 StartTaskCycles, int64 StartTaskNum)
+{
+	const FAutoSaveCounters& Counters = Subsystem->GetCounters();
+
+	const int64 TaskNum = Counters.GameThreadTaskNum - StartTaskNum;
+	const double TaskSeconds = FPlatformTime::ToSeconds64(Counters.GameThreadTaskCycles - StartTaskCycles);
+
+	TSharedRef<FJsonObject> Phase = MakeShared<FJsonObject>();
+	Phase->SetStringField(TEXT("Name"), Name);
+	Phase->SetNumberField(TEXT("Seconds"), Seconds);
+	Phase->SetNumberField(TEXT("Jobs"), JobNum);
+	Phase->SetNumberField(TEXT("JobsPerSecond"), Seconds > 0.0 ? JobNum / Seconds : 0.0);
+	Phase->SetNumberField(TEXT("Bytes"), ByteNum);
+	Phase->SetNumberField(TEXT("BytesPerSecond"), Seconds > 0.0 ? ByteNum / Seconds : 0.0);
+	Phase->SetNumberField(TEXT("GameThreadTasks"), TaskNum);
+	Phase->SetNumberField(TEXT("GameThreadMsPerTask"), TaskNum ? TaskSeconds * 1000.0 / TaskNum : 0.0);
+	Phase->SetObjectField(TEXT("Ticks"), DescribeTickTimes(TickTimes));
+	Phase->SetNumberField(TEXT("UsedPhysical"), FPlatformMemory::GetStats().UsedPhysical);
+
+	Phases.Add(MakeShared<FJsonValueObject>(Phase));
+
+	Test.AddInfo(FString::Printf(TEXT("%s: %d jobs, %lld bytes in %.3f s"), *Name, JobNum, ByteNum, Seconds));
+}
+
+bool FAutoSaveBenchmark::Run()
+{
+	UE_LOG(LogAutoSave, Display, TEXT("Benchmark of %d %s with %lld bytes each on %d threads"), Count, *GetStruct()->GetName(), Size, ThreadNum);
+
+	const FPlatformMemoryStats StartMemory = FPlatformMemory::GetStats();
+
+	// The structs do not exist yet, each load only probes for the file
+	{
+		TArray<double> TickTimes;
+		const uint64 StartTaskCycles = Subsystem->GetCounters().GameThreadTaskCycles;
+		const int64 StartTaskNum = Subsystem->GetCounters().GameThreadTaskNum;
+		const double StartTime = FPlatformTime::Seconds();
+
+		LoadedNum = 0;
+		AcquireAll();
+
+		if (!TickUntil([this]() { return LoadedNum >= Count; }, TickTimes)) return false;
+
+		AddPhase(TEXT("Create"), FPlatformTime::Seconds() - StartTime, Count, 0, TickTimes, StartTaskCycles, StartTaskNum);
+	}
+
+	FillAll();
+
+	int64 FileSize = 0;
+
+	// The flush blocks the frame it is called in, so it is sampled as a tick, the tasks are finished by the following ticks
+	{
+		TArray<double> TickTimes;
+		const uint64 StartTaskCycles = Subsystem->GetCounters().GameThreadTaskCycles;
+		const int64 StartTaskNum = Subsystem->GetCounters().GameThreadTaskNum;
+		const double StartTime = FPlatformTime::Seconds();
+
+		const TArray<FString> Unsaved = Subsystem->FlushSaveStructs();
+
+		TickTimes.Add(FPlatformTime::Seconds() - StartTime);
+
+		if (!TickUntil([this]() { return Subsystem->GetInFlightTaskNum() == 0; }, TickTimes)) return false;
+
+		if (Unsaved.Num())
+		{
+			Test.AddError(FString::Printf(TEXT("%d of the structs were not saved."), Unsaved.Num()));
+		}
+
+		const double Seconds = FPlatformTime::Seconds() - StartTime;
+
+		FileSize = GetFileSize();
+
+		AddPhase(TEXT("Save"), Seconds, Count - Unsaved.Num(), FileSize, TickTimes, StartTaskCycles, StartTaskNum);
+	}
+
+	{
+		TArray<double> TickTimes;
+		const uint64 StartTaskCycles = Subsystem->GetCounters().GameThreadTaskCycles;
+		const int64 StartTaskNum = Subsystem->GetCounters().GameThreadTaskNum;
+		const double StartTime = FPlatformTime::Seconds();
+
+		ReleaseAll();
+
+		if (!TickUntil([this]() { return IsReleased(); }, TickTimes)) return false;
+
+		AddPhase(TEXT("Release"), FPlatformTime::Seconds() - StartTime, Count, FileSize, TickTimes, StartTaskCycles, StartTaskNum);
+	}
+
+	// Every struct left the memory, so each is read from its file
+	{
+		TArray<double> TickTimes;
+		const uint64 StartTaskCycles = Subsystem->GetCounters().GameThreadTaskCycles;
+		const int64 StartTaskNum = Subsystem->GetCounters().GameThreadTaskNum;
+		const double StartTime = FPlatformTime::Seconds();
+
+		LoadedNum = 0;
+		AcquireAll();
+
+		if (!TickUntil([this]() { return LoadedNum >= Count; }, TickTimes)) return false;
+
+		AddPhase(TEXT("Load"), FPlatformTime::Seconds() - StartTime, Count, FileSize, TickTimes, StartTaskCycles, StartTaskNum);
+	}
+
+	// A part of the structs is released and acquired again every frame
+	if (ChurnNum > 0)
+	{
+		TArray<double> TickTimes;
+		const uint64 StartTaskCycles = Subsystem->GetCounters().GameThreadTaskCycles;
+		const int64 StartTaskNum = Subsystem->GetCounters().GameThreadTaskNum;
+		const int32 ChurnCount = FMath::Clamp(FMath::CeilToInt(Count * ChurnRatio), 1, Count);
+		const double StartTime = FPlatformTime::Seconds();
+
+		FRandomStream Random(Count);
+
+		LoadedNum = 0;
+
+		for (int32 Iteration = 0; Iteration < ChurnNum; ++Iteration)
+		{
+			TArray<FString> Churned;
+
+			const int32 ChurnStart = Random.RandHelper(Count);
+
+			for (int32 Index = 0; Index < ChurnCount; ++Index)
+			{
+				Churned.Add(Filenames[(ChurnStart + Index) % Count]);
+				Subsystem->RemoveSaveStructRef(Churned.Last());
+			}
+
+			TickOnce(TickTimes);
+
+			for (const FString& Filename : Churned)
+			{
+				Acquire(Filename);
+			}
+
+			TickOnce(TickTimes);
+		}
+
+		if (!TickUntil([this, ChurnCount]() { return LoadedNum >= ChurnNum * ChurnCount; }, TickTimes)) return false;
+
+		AddPhase(TEXT("Churn"), FPlatformTime::Seconds() - StartTime, ChurnNum * ChurnCount, 0, TickTimes, StartTaskCycles, StartTaskNum);
+	}
+
+	{
+		TArray<double> TickTimes;
+
+		ReleaseAll();
+
+		if (!TickUntil([this]() { return IsReleased(); }, TickTimes)) return false;
+	}
+
+	WriteResult(StartMemory);
+
+	return true;
+}
+
+void FAutoSaveBenchmark::WriteResult(const FPlatformMemoryStats& StartMemory)
+{
+	const FPlatformMemoryStats EndMemory = FPlatformMemory::GetStats();
+
+	TSharedRef<FJsonObject> Config = MakeShared<FJsonObject>();
+	Config->SetStringField(TEXT("Struct"), GetStruct()->GetName());
+	Config->SetNumberField(TEXT("Count"), Count);
+	Config->SetNumberField(TEXT("Size"), Size);
+	Config->SetNumberField(TEXT("Churn"), ChurnNum);
+	Config->SetNumberField(TEXT("ChurnRatio"), ChurnRatio);
+	Config->SetNumberField(TEXT("FrameTime"), FrameTime);
+	Config->SetNumberField(TEXT("MaxThreadNum"), Subsystem->MaxThreadNum);
+	Config->SetNumberField(TEXT("SaveBatchSize"), Subsystem->SaveBatchSize);
+	Config->SetBoolField(TEXT("ExplicitDirtyTracking"), Subsystem->bExplicitDirtyTracking);
+	Config->SetBoolField(TEXT("JournaledStorage"), Subsystem->bJournaledStorage);
+	Config->SetBoolField(TEXT("SerializationPlans"), Subsystem->bSerializationPlans);
+	Config->SetBoolField(TEXT("DurableSaves"), Subsystem->bDurableSaves);
+	Config->SetNumberField(TEXT("IncrementalSnapshotSize"), Subsystem->IncrementalSnapshotSize);
+	Config->SetNumberField(TEXT("StreamingSaveSize"), Subsystem->StreamingSaveSize);
+	Config->SetNumberField(TEXT("MappedLoadSize"), Subsystem->MappedLoadSize);
+
+	TSharedRef<FJsonObject> Memory = MakeShared<FJsonObject>();
+	Memory->SetNumberField(TEXT("StartUsedPhysical"), StartMemory.UsedPhysical);
+	Memory->SetNumberField(TEXT("EndUsedPhysical"), EndMemory.UsedPhysical);
+	Memory->SetNumberField(TEXT("PeakUsedPhysical"), EndMemory.PeakUsedPhysical);
+
+	const FAutoSavePayloadStats PayloadStats = Subsystem->GetPayloadStats();
+
+	Memory->SetNumberField(TEXT("PayloadAllocations"), PayloadStats.AllocationNum);
+	Memory->SetNumberField(TEXT("PayloadReused"), PayloadStats.ReusedNum);
+	Memory->SetNumberField(TEXT("PayloadCacheSize"), PayloadStats.CachedSize);
+	Memory->SetNumberField(TEXT("InfoPoolCapacity"), Subsystem->GetInfoPoolCapacity());
+
+	// The subsystem only served this case, so the latencies are the ones of its phases
+	TSharedRef<FJsonObject> Latency = MakeShared<FJsonObject>();
+	Latency->SetObjectField(TEXT("QueueWait"), DescribeHistogram(Subsystem->GetCounters().QueueWaitLatency));
+	Latency->SetObjectField(TEXT("Serialize"), DescribeHistogram(Subsystem->GetCounters().SerializeLatency));
+	Latency->SetObjectField(TEXT("IO"), DescribeHistogram(Subsystem->GetCounters().IOLatency));
+
+	TSharedRef<FJsonObject> Result = MakeShared<FJsonObject>();
+	Result->SetStringField(TEXT("Time"), FDateTime::UtcNow().ToIso8601());
+	Result->SetStringField(TEXT("Platform"), FPlatformProperties::IniPlatformName());
+	Result->SetObjectField(TEXT("Config"), Config);
+	Result->SetArrayField(TEXT("Phases"), Phases);
+	Result->SetObjectField(TEXT("Memory"), Memory);
+	Result->SetObjectField(TEXT("Latency"), Latency);
+
+	FString Output;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Output);
+	FJsonSerializer::Serialize(Result, Writer);
+
+	const FString ResultFilename = GetBenchmarkDir() / TEXT("Results") / FString::Printf(TEXT("%s-%s-%d-%lld-%d.json"),
+		*FDateTime::Now().ToString(), bNumeric ? TEXT("Numeric") : TEXT("Payload"), Count, Size, ThreadNum);
+
+	if (!FFileHelper::SaveStringToFile(Output, *ResultFilename))
+	{
+		Test.AddError(FString::Printf(TEXT("Failed to write the benchmark results to %s"), *ResultFilename));
+		return;
+	}
+
+	Test.AddInfo(FString::Printf(TEXT("Results written to %s"), *ResultFilename));
+}
+
+#endif
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AutoSaveSubsystem.h"
+#include "AutoSaveBenchmark.generated.h"
+
+// Synthetic save struct of the benchmark, the size is set by the payload
+USTRUCT()
+struct FAutoSaveBenchmarkStruct : public FSaveStruct
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	int32 Index = 0;
+
+	UPROPERTY()
+	float Values[16];
+
+	UPROPERTY()
+	FString Name;
+
+	UPROPERTY()
+	TArray<uint8> Payload;
+};
+
+// Synthetic save struct of numeric arrays
+USTRUCT()
+struct FAutoSaveBenchmarkNumericStruct : public FSaveStruct
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	int32 Index = 0;
+
+	UPROPERTY()
+	FVector Origin = FVector::ZeroVector;
+
+	UPROPERTY()
+	TArray<FVector> Points;
+
+	UPROPERTY()
+	TArray<int32> Counters;
+};
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// One case of the AutoSave.Benchmark automation test, drives a subsystem of its own with synthetic save structs and writes the measurements as JSON.
+// The subsystem runs with the project settings, except for the ones of the case and the pack and the resident cache, which are disabled.
+class FAutoSaveBenchmark
+{
+public:
+
+	FAutoSaveBenchmark(class FAutomationTestBase& InTest, const FString& Parameters);
+
+	~FAutoSaveBenchmark();
+
+	bool Run();
+
+private:
+
+	class FAutomationTestBase& Test;
+
+	class UGameInstance* GameInstance = nullptr;
+
+	UAutoSaveSubsystem* Subsystem = nullptr;
+
+	int32 Count = 100;
+
+	int64 Size = 1024;
+
+	int32 ThreadNum = 4;
+
+	bool bNumeric = false;
+
+	int32 ChurnNum = 16;
+
+	float ChurnRatio = 0.1f;
+
+	float FrameTime = 0.0f;
+
+	// Created for the case only and removed with it
+	FString Directory;
+
+	TArray<FString> Filenames;
+
+	// Load callbacks called so far, loading and failing alike
+	int32 LoadedNum = 0;
+
+	TArray<TSharedPtr<class FJsonValue>> Phases;
+
+	UScriptStruct* GetStruct() const;
+
+	void Acquire(const FString& Filename);
+
+	void AcquireAll();
+
+	void ReleaseAll();
+
+	void FillAll();
+
+	bool IsReleased() const;
+
+	int64 GetFileSize() const;
+
+	// Tick the subsystem until the condition holds, the tick times are added to the samples, false if the phase timed out
+	bool TickUntil(TFunctionRef<bool()> Condition, TArray<double>& TickTimes);
+
+	void TickOnce(TArray<double>& TickTimes);
+
+	void AddPhase(const FString& Name, double Seconds, int32 JobNum, int64 ByteNum, const TArray<double>& TickTimes, uint64 StartTaskCycles, int64 StartTaskNum);
+
+	void WriteResult(const FPlatformMemoryStats& StartMemory);
+
+};
+
+#endif